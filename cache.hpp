@@ -0,0 +1,114 @@
+#pragma once
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "parser.hpp"
+
+namespace cmd {
+    /// A bounded cache of parsed command strings, with CLOCK replacement.
+    /// On a hit, the result and everything the parser captured are restored
+    /// without splitting the command or walking the parse tree,
+    /// so the parser ends up in the same state as after an uncached `parse`.
+    /// \tparam Parser: type of the `parser`
+    /// \remark Like `parser::parse`, the parser should be `reset` before each call to `parse`.
+    template <typename Parser>
+    class parse_cache {
+    public:
+        using parser_type = Parser;
+        using string_type = Parser::string_type;
+        using string_view_type = Parser::string_view_type;
+        using hash_type = Parser::hash_type;
+        /// `std::expected<parse_result, parse_error>`, same as from `parser::parse(const Str&)`.
+        using return_type = decltype(std::declval<Parser&>().parse(std::declval<const string_view_type&>()));
+    private:
+        struct entry {
+            string_type command;
+            return_type result;
+            Parser::snapshot state;
+            bool referenced = false;
+        };
+        struct key_hash {
+            std::size_t operator()(string_view_type str) const {
+                return hash_type{}(str);
+            }
+        };
+        std::vector<std::optional<entry>> entries_;
+        /// \internal Result of the last `parse` when nothing can be cached.
+        std::optional<return_type> uncached_;
+        /// \internal Keys are views of `entry::command`.
+        std::unordered_map<string_view_type, std::size_t, key_hash> index_{};
+        std::size_t hand_ = 0, hits_ = 0, misses_ = 0;
+        static constexpr bool measured = !std::same_as<typename Parser::metrics_type, no_metrics>;
+
+        /// \return index of a free slot, evicting an entry if the cache is full
+        std::size_t make_room() {
+            if (index_.size() < entries_.size()) return index_.size();
+            while (entries_[hand_]->referenced) {
+                entries_[hand_]->referenced = false;
+                hand_ = (hand_ + 1) % entries_.size();
+            }
+            const std::size_t slot = hand_;
+            hand_ = (hand_ + 1) % entries_.size();
+            index_.erase(entries_[slot]->command);
+            return slot;
+        }
+    public:
+        /// \param capacity: maximum number of commands cached
+        explicit parse_cache(std::size_t capacity) : entries_(capacity) {
+            index_.reserve(capacity);
+        }
+
+        /// Same as `parser.parse(command)`, except that the result may come from the cache.
+        /// A hit is recorded in `Parser::metrics_type` like a parse, with the time taken by the lookup and restore.
+        /// \return reference to the cached result, so that a hit does not copy its arguments.
+        /// It is valid until the next call to `parse` or `clear`, which may evict it.
+        const return_type& parse(Parser& parser, string_view_type command) {
+            std::chrono::steady_clock::time_point start;
+            if constexpr (measured) start = std::chrono::steady_clock::now();
+            if (const auto it = index_.find(command); it != index_.end()) {
+                entry& e = *entries_[it->second];
+                e.referenced = true;
+                ++hits_;
+                parser.restore(e.state);
+                if constexpr (measured) {
+                    const std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - start;
+                    if (e.result) {
+                        Parser::metrics_type::record(e.result->usage_index, latency);
+                    } else {
+                        Parser::metrics_type::record(e.result.error().type, latency);
+                    }
+                }
+                return e.result;
+            }
+            ++misses_;
+            if (entries_.empty()) {
+                return uncached_.emplace(parser.parse(command));
+            }
+            const std::size_t slot = make_room();
+            entries_[slot].emplace(entry{string_type{command}, parser.parse(command), parser.save()});
+            index_.emplace(entries_[slot]->command, slot);
+            return entries_[slot]->result;
+        }
+        std::size_t hits() const noexcept {
+            return hits_;
+        }
+        std::size_t misses() const noexcept {
+            return misses_;
+        }
+        /// \return number of commands cached
+        std::size_t size() const noexcept {
+            return index_.size();
+        }
+        std::size_t capacity() const noexcept {
+            return entries_.size();
+        }
+        /// Removes all entries. Counters are kept.
+        void clear() noexcept {
+            index_.clear();
+            for (auto& e : entries_) e.reset();
+            uncached_.reset();
+            hand_ = 0;
+        }
+    };
+}
\ No newline at end of file
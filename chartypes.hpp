@@ -53,11 +53,14 @@ namespace cmd {
         /// \param size_mul: size of output buffer in multiples of `in.size`
         /// \param locale: locale that the conversion should be based on
         /// (if not specified, the global locale is used)
+        /// \param alloc: allocator of the output string
         /// \throw std::bad_cast if conversion facet does not exist
         /// \throw std::runtime_error if there is any error during conversion
-        std::basic_string<OutCharT> operator()
-        (std::basic_string_view<InCharT> in, std::size_t size_mul = default_size_mul, const std::locale& locale = {}) const {
-            std::basic_string<OutCharT> out(in.size() * size_mul, 0);
+        template <typename Allocator = std::allocator<OutCharT>>
+        std::basic_string<OutCharT, std::char_traits<OutCharT>, Allocator> operator()
+        (std::basic_string_view<InCharT> in, std::size_t size_mul = default_size_mul, const std::locale& locale = {},
+        const Allocator& alloc = {}) const {
+            std::basic_string<OutCharT, std::char_traits<OutCharT>, Allocator> out(in.size() * size_mul, 0, alloc);
             const auto& facet = std::use_facet<converter_type>(locale);
             std::mbstate_t mb{};
             const InCharT* from_next;
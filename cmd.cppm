@@ -0,0 +1,73 @@
+// Module interface of the parser, for `import cmd;` instead of including the headers.
+// The headers are included in the global module fragment, and the public names are re-exported from it,
+// so a translation unit can both import the module and include the other headers of the library.
+// Macros (e.g. CONFIG_DEFAULT) are not exported.
+module;
+#include "parser.hpp"
+#include "config_default.hpp"
+
+export module cmd;
+
+export namespace cmd {
+    // common.hpp
+    using cmd::follow_const;
+    using cmd::follow_const_t;
+    using cmd::receiver_type;
+    using cmd::receiver_type_t;
+    using cmd::is_template_instance;
+    using cmd::is_template_instance_v;
+    using cmd::constexpr_eval;
+    using cmd::tagged;
+    using cmd::equiv_to;
+    using cmd::fixed_string;
+    // chartypes.hpp
+    using cmd::char_like;
+    using cmd::output_object;
+    using cmd::input_object;
+    using cmd::translator;
+    // hash.hpp
+    using cmd::hash;
+    // parser.hpp
+    using cmd::error_type;
+    using cmd::error_types_n;
+    using cmd::usage_id;
+    using cmd::usage_tag;
+    using cmd::usage;
+    using cmd::special_chars;
+    using cmd::input_limits;
+    using cmd::config_tag;
+    using cmd::config_default;
+    using cmd::config;
+    using cmd::config_instance;
+    using cmd::parse_node_type;
+    using cmd::parse_node;
+    using cmd::flag_info;
+    using cmd::hasher;
+    using cmd::parser_def_tag;
+    using cmd::parser_def;
+    using cmd::parser_info_tag;
+    using cmd::parser_info;
+    using cmd::error_loc;
+    using cmd::receiver;
+    using cmd::delimited_range;
+    using cmd::no_metrics;
+    using cmd::no_response_files;
+    using cmd::trace_event;
+    using cmd::trace_events_n;
+    using cmd::no_tracer;
+    using cmd::default_policy;
+    using cmd::error_ref_c_tag;
+    using cmd::error_ref_tag;
+    using cmd::error_tag;
+    using cmd::parse_result_tag;
+    using cmd::parser;
+    using cmd::dynamic_flag_info;
+    using cmd::compiled_usages;
+    using cmd::config_type_of;
+    using cmd::define_parser;
+
+    namespace pmr {
+        using cmd::pmr::policy;
+        using cmd::pmr::parser;
+    }
+}
\ No newline at end of file
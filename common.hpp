@@ -65,7 +65,7 @@ namespace cmd {
     template <template <typename...> typename Tmpl, typename... Ts>
     struct is_template_instance<Tmpl, Tmpl<Ts...>> : std::true_type {};
     template <template <typename...> typename Tmpl, typename T>
-    constexpr bool is_template_instance_v = is_template_instance<Tmpl, std::remove_cvref_t<T>>::value;
+    inline constexpr bool is_template_instance_v = is_template_instance<Tmpl, std::remove_cvref_t<T>>::value;
 
     template <auto Value>
     struct constexpr_eval {};
@@ -74,4 +74,19 @@ namespace cmd {
     concept tagged = std::same_as<typename T::tag, Tag>;
     template <typename T, typename Ref>
     concept equiv_to = std::is_same_v<std::remove_cvref_t<Ref>, T>;
+
+    /// A string literal that can be passed as a template argument, e.g. to `parser::precompiled`.
+    template <typename CharT, std::size_t N>
+    struct fixed_string {
+        using char_type = CharT;
+        CharT value[N]{};
+
+        consteval fixed_string(const CharT (&str)[N]) noexcept {
+            for (std::size_t i = 0; i < N; ++i) value[i] = str[i];
+        }
+        /// \return length of the string, excluding the terminating null character
+        static constexpr std::size_t size() noexcept {
+            return N - 1;
+        }
+    };
 }
\ No newline at end of file
@@ -22,7 +22,8 @@ namespace cmd {
             CharT_prefix##'^',\
             CharT_prefix##"(", CharT_prefix##")", CharT_prefix##"|",\
             CharT_prefix##"[", CharT_prefix##"]", CharT_prefix##"-",\
-            CharT_prefix##"<", CharT_prefix##">", CharT_prefix##"...", CharT_prefix##"=", CharT_prefix##"..."\
+            CharT_prefix##"<", CharT_prefix##">", CharT_prefix##"...", CharT_prefix##"=", CharT_prefix##"...",\
+            CharT_prefix##"->", CharT_prefix##';'\
         };\
         static constexpr std::array<format_string_type, error_types_n> error_msgs = {\
             FmtCharT_prefix##"Unknown option.",\
@@ -32,7 +33,10 @@ namespace cmd {
             FmtCharT_prefix##"Unknown flag.",\
             FmtCharT_prefix##"Flag does not accept argument.",\
             FmtCharT_prefix##"At least one special character is still open.",\
-            FmtCharT_prefix##"Invalid argument: "\
+            FmtCharT_prefix##"Invalid argument: ",\
+            FmtCharT_prefix##"Cannot read response file.",\
+            FmtCharT_prefix##"Response files are nested too deeply.",\
+            FmtCharT_prefix##"Command exceeds input limits."\
         };\
     };
     CONFIG_DEFAULT(char, , char, )
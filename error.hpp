@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <string_view>
+#include <algorithm>
 #include <charconv>
 #include "common.hpp"
 
@@ -23,15 +24,13 @@ namespace cmd::detail {
         template <typename ConfigT>
         constexpr define_error(const ConfigT& config, const auto& refs) noexcept {
             using enum define_error_ref_type;
+            // usages may be defined at runtime (see `compiled_tree::compile`), so every write is clamped to `end`
             char *current = buffer_, *const end = buffer_ + define_error_buffer_size;
-            auto append = [this, &current](std::string_view str) {
-                current = ranges::copy(str, current).out;
+            auto append = [&current, end](std::string_view str) {
+                current = ranges::copy(str.substr(0, std::min<std::size_t>(str.size(), end - current)), current).out;
             };
-            auto append_n_spaces = [this, &current](std::size_t n) {
-                for (std::size_t i = 0; i < n; ++i) {
-                    current[i] = ' ';
-                }
-                current += n;
+            auto append_n_spaces = [&current, end](std::size_t n) {
+                current = ranges::fill_n(current, std::min<std::size_t>(n, end - current), ' ');
             };
             append("Parse error.\n");
             std::vector<std::pair<char[index_str_buffer_size], std::size_t>> index_strs;
@@ -87,4 +86,37 @@ namespace cmd::detail {
             return size_;
         }
     };
+    /// Diagnostic of a command that cannot be parsed at compile time, see `parser::precompiled`.
+    struct precompile_error {
+    private:
+        char buffer_[define_error_buffer_size]{};
+        std::size_t size_;
+    public:
+        /// \param what: error message, or empty if it is not in `char`
+        /// \param arg_loc: index of the argument that causes the error, or -1 if it cannot be pinpointed
+        /// \param arg: the argument, or empty if it is not in `char`
+        constexpr precompile_error(std::string_view what, std::size_t arg_loc, std::string_view arg) noexcept {
+            char *current = buffer_, *const end = buffer_ + define_error_buffer_size;
+            auto append = [&current, end](std::string_view str) {
+                current = ranges::copy(str.substr(0, std::min<std::size_t>(str.size(), end - current)), current).out;
+            };
+            append("Parse error in precompiled command.\n\033[31mError: \033[0m");
+            append(what);
+            if (arg_loc != -1uz) {
+                append("\nAt argument no. ");
+                current = std::to_chars(current, end, arg_loc).ptr;
+                if (!arg.empty()) {
+                    append(": ");
+                    append(arg);
+                }
+            }
+            size_ = current - buffer_;
+        }
+        [[nodiscard]] constexpr const char* data() const noexcept {
+            return buffer_;
+        }
+        [[nodiscard]] constexpr std::size_t size() const noexcept {
+            return size_;
+        }
+    };
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "parser.hpp"
+
+namespace cmd {
+    /// Reads commands from many file descriptors (pipes, ttys, sockets, ...) on a single thread.
+    /// Descriptors are switched to non-blocking mode and watched with `epoll`.
+    /// Each stream is split into commands by `config.specials.enter`,
+    /// and every command is parsed by the same `parser` through a `parse_session`,
+    /// so partial commands cost nothing until the rest arrives.
+    /// \tparam Parser: type of the `parser`
+    /// \remark Only available on Linux. Blank commands are skipped, like `parser::readline` does.
+    template <typename Parser>
+    requires std::same_as<typename Parser::char_type, char>
+    class event_loop {
+    public:
+        using parser_type = Parser;
+        using session_type = Parser::parse_session;
+        /// `std::expected<parse_result, parse_error>` that owns its arguments.
+        using result_type = decltype(std::declval<session_type&>().finish());
+        /// Called with the descriptor and the result of each command.
+        /// Variables and flags of the `parser` are valid until the callback returns.
+        using command_callback = std::function<void(int, const result_type&)>;
+        /// Called with the descriptor after a stream is unregistered because it has ended,
+        /// and the `errno` of the failed read (0 if the end of the stream was reached).
+        using close_callback = std::function<void(int, int)>;
+        static constexpr std::size_t buffer_size = 4096, max_events = 64;
+    private:
+        static constexpr const auto& specials = Parser::config.specials;
+        struct stream {
+            session_type session;
+            command_callback on_command;
+            close_callback on_close;
+            /// Whether only delimiters have been read for the current command.
+            bool blank = true;
+        };
+        Parser& parser_;
+        int epoll_fd_;
+        std::unordered_map<int, stream> streams_{};
+        /// \internal Descriptor whose callback is running, and whether it was removed by the callback.
+        int dispatching_ = -1;
+        bool removed_ = false;
+
+        /// Parses the command read by `s` (unless it is blank), then calls its callback.
+        /// \return whether `fd` is still registered
+        bool dispatch(int fd, stream& s) {
+            if (s.blank) return true;
+            s.blank = true;
+            const result_type res = s.session.finish();
+            dispatching_ = fd;
+            s.on_command(fd, res);
+            dispatching_ = -1;
+            parser_.reset();
+            if (removed_) [[unlikely]] {
+                removed_ = false;
+                streams_.erase(fd);
+                return false;
+            }
+            return true;
+        }
+        /// Unregisters `fd` when its stream ends.
+        /// \param error: `errno` of the failed read, or 0 if the end of the stream is reached
+        void end(int fd, stream& s, int error) {
+            if (!error && !dispatch(fd, s)) return;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            close_callback on_close = std::move(s.on_close);
+            streams_.erase(fd);
+            if (on_close) on_close(fd, error);
+        }
+        /// Reads from `fd` until it would block.
+        /// \return number of commands parsed
+        std::size_t read(int fd) {
+            std::array<char, buffer_size> buffer;
+            std::size_t commands = 0;
+            while (true) {
+                const auto it = streams_.find(fd);
+                if (it == streams_.end()) return commands;
+                // a callback may `add` streams, which can rehash `streams_` and invalidate `it`, but not `s`
+                stream& s = it->second;
+                const ssize_t size = ::read(fd, buffer.data(), buffer.size());
+                if (size < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) return commands;
+                }
+                if (size <= 0) [[unlikely]] {
+                    if (size == 0 && !s.blank) ++commands;
+                    end(fd, s, size < 0 ? errno : 0);
+                    return commands;
+                }
+                std::string_view chunk{buffer.data(), static_cast<std::size_t>(size)};
+                while (true) {
+                    const std::size_t eol = chunk.find(specials.enter);
+                    const std::string_view part = chunk.substr(0, eol);
+                    if (s.blank && part.find_first_not_of(specials.delimiter) != part.npos) {
+                        s.blank = false;
+                    }
+                    s.session.feed(part);
+                    if (eol == chunk.npos) break;
+                    chunk.remove_prefix(eol + 1);
+                    if (!s.blank) ++commands;
+                    if (!dispatch(fd, s)) return commands;
+                }
+            }
+        }
+    public:
+        /// \throw std::system_error if an `epoll` instance cannot be created
+        explicit event_loop(Parser& parser) : parser_{parser}, epoll_fd_{epoll_create1(EPOLL_CLOEXEC)} {
+            if (epoll_fd_ < 0) {
+                throw std::system_error(errno, std::system_category(), "epoll_create1");
+            }
+        }
+        event_loop(const event_loop&) = delete;
+        event_loop& operator=(const event_loop&) = delete;
+        ~event_loop() {
+            ::close(epoll_fd_);
+        }
+
+        /// Starts reading commands from `fd`. The descriptor is not owned by the loop.
+        /// \throw std::system_error if `fd` cannot be made non-blocking or watched
+        void add(int fd, command_callback on_command, close_callback on_close = {}) {
+            const int flags = fcntl(fd, F_GETFL);
+            if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+                throw std::system_error(errno, std::system_category(), "fcntl");
+            }
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+                throw std::system_error(errno, std::system_category(), "epoll_ctl");
+            }
+            streams_.emplace(fd, stream{session_type{parser_}, std::move(on_command), std::move(on_close)});
+        }
+        /// Stops reading commands from `fd`, discarding any partial command.
+        /// \remark It is safe to call this in a callback.
+        void remove(int fd) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            if (fd == dispatching_) {
+                removed_ = true;
+            } else {
+                streams_.erase(fd);
+            }
+        }
+        /// \return number of descriptors being watched
+        std::size_t size() const noexcept {
+            return streams_.size();
+        }
+        /// Waits for input once, and handles all streams that are ready.
+        /// \param timeout: in milliseconds, or -1 to wait indefinitely
+        /// \return number of commands parsed
+        /// \throw std::system_error if waiting fails
+        std::size_t poll(int timeout = -1) {
+            std::array<epoll_event, max_events> events;
+            int n;
+            do {
+                n = epoll_wait(epoll_fd_, events.data(), max_events, timeout);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0) [[unlikely]] {
+                throw std::system_error(errno, std::system_category(), "epoll_wait");
+            }
+            std::size_t commands = 0;
+            for (const epoll_event& event : events | views::take(n)) {
+                commands += read(event.data.fd);
+            }
+            return commands;
+        }
+        /// Handles input until all streams have ended or been removed.
+        void run() {
+            while (!streams_.empty()) poll();
+        }
+    };
+}
\ No newline at end of file
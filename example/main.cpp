@@ -7,14 +7,22 @@
 #include <cmath>
 #include <limits>
 #include <locale>
+#ifdef COMMAND_LINE_PARSER_IMPORT
+import cmd;
+#else
 #include <parser.hpp>
 #include <config_default.hpp> // for default diagnostic messages
+#endif
 
 static_assert(std::numeric_limits<double>::is_iec559, "This program requires IEEE754 standard.");
 
 enum class action {
     arithmetic, sqrt, save, read, help, exit
 };
+/// Options of <op>, in the order they are declared.
+enum class op {
+    add, minus, mul, div
+};
 constexpr auto config = []() {
     cmd::config<action, char16_t, char>::type config{
         .name = "Calculator",
@@ -77,21 +85,30 @@ int run(const auto& res) {
         };
         switch (res->result) {
             case arithmetic: {
-                std::u16string_view op = parser.var(u"op");
                 number_t first, second;
                 to_number(u"first", first);
                 to_number(u"second", second);
                 if (!success) return EXIT_FAILURE;
-                if (op == u"add") {
-                    result = first + second;
-                } else if (op == u"minus") {
-                    result = first - second;
-                } else if (op == u"mul") {
-                    result = first * second;
-                } else if (op == u"div") {
-                    result = first / second;
-                } else {
-                    std::unreachable();
+                switch (parser.choice<op>(u"op")) {
+                    case op::add: {
+                        result = first + second;
+                        break;
+                    }
+                    case op::minus: {
+                        result = first - second;
+                        break;
+                    }
+                    case op::mul: {
+                        result = first * second;
+                        break;
+                    }
+                    case op::div: {
+                        result = first / second;
+                        break;
+                    }
+                    default: {
+                        std::unreachable();
+                    }
                 }
                 break;
             }
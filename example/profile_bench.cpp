@@ -0,0 +1,110 @@
+// Parses a skewed workload, where 90% of commands are the three subcommands declared last,
+// with and without a profile of the workload.
+// `profile_bench --record profile_bench.inc` writes the profile, which is compiled into the second parser.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string_view>
+#include <vector>
+#include <parser.hpp>
+#include <config_default.hpp>
+#include <trace.hpp>
+
+using namespace std::literals;
+
+constexpr cmd::config<int>::type config{
+    .name = "vcs",
+    .usages = {
+        {"init [--bare]", 1},
+        {"clone <url> [--depth=<depth>]", 2},
+        {"add <path> [--force]", 3},
+        {"mv <from> <to>", 4},
+        {"restore <path> [--staged]", 5},
+        {"rm <path> [--cached]", 6},
+        {"bisect (start|good|bad|reset)", 7},
+        {"diff [--cached] [--stat]", 8},
+        {"grep <pattern>", 9},
+        {"show <object>", 10},
+        {"branch <name> [--delete]", 11},
+        {"commit [--message=<message>] [--amend]", 12},
+        {"merge <branch> [--no-ff]", 13},
+        {"rebase <upstream> [--interactive]", 14},
+        {"reset <commit> [--hard]", 15},
+        {"switch <branch> [--create]", 16},
+        {"tag <name> [--delete]", 17},
+        {"fetch <remote> [--prune]", 18},
+        {"pull <remote> [--rebase]", 19},
+        {"push <remote> [--force]", 20},
+        {"log [--oneline] [--max=<n>]", 21},
+        {"status [--short]", 22}
+    }
+};
+constexpr auto info = cmd::define_parser<config>();
+constexpr std::array<std::uint64_t, info.tree.size()> profile{
+#include "profile_bench.inc"
+};
+constexpr auto profiled_info = cmd::define_parser<config, profile>();
+
+struct profile_policy : cmd::default_policy {
+    using tracer_type = cmd::node_profile<info>;
+};
+
+/// \return `count` commands, 90% of which are `push`, `log` or `status`
+std::vector<std::vector<std::string_view>> workload(std::size_t count) {
+    const std::array<std::vector<std::string_view>, 8> cold{{
+        {"init"}, {"add", "file"}, {"mv", "a", "b"}, {"diff", "--stat"},
+        {"branch", "topic"}, {"commit", "--amend"}, {"fetch", "origin"}, {"pull", "origin"}
+    }};
+    const std::array<std::vector<std::string_view>, 3> hot{{
+        {"push", "origin", "--force"}, {"log", "--oneline"}, {"status", "--short"}
+    }};
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> percent{0, 99};
+    std::vector<std::vector<std::string_view>> out;
+    out.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (percent(gen) < 90) {
+            out.push_back(hot[gen() % hot.size()]);
+        } else {
+            out.push_back(cold[gen() % cold.size()]);
+        }
+    }
+    return out;
+}
+
+template <typename Parser>
+double ns_per_command(Parser& parser, const std::vector<std::vector<std::string_view>>& commands) {
+    std::size_t matched = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 20; ++round) {
+        for (const auto& args : commands) {
+            matched += parser.parse(args).has_value();
+            parser.reset();
+        }
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    if (matched != commands.size() * 20) std::puts("unexpected parse error");
+    return elapsed.count() / static_cast<double>(matched);
+}
+
+int main(int argc, char* argv[]) {
+    const auto commands = workload(100000);
+    if (argc == 3 && argv[1] == "--record"sv) {
+        cmd::parser<info, profile_policy> parser;
+        for (const auto& args : commands) {
+            parser.parse(args);
+            parser.reset();
+        }
+        std::ofstream out{argv[2]};
+        parser.tracer().write(std::ostreambuf_iterator{out});
+        return 0;
+    }
+    cmd::parser<info> parser;
+    cmd::parser<profiled_info> profiled_parser;
+    for (int i = 0; i < 3; ++i) {
+        std::printf("declaration order: %.1f ns/command, profiled order: %.1f ns/command\n",
+            ns_per_command(parser, commands), ns_per_command(profiled_parser, commands));
+    }
+}
@@ -0,0 +1,116 @@
+// A multi-tool with a dozen parsers, built twice (see CMakeLists.txt) to compare the code size of
+// parsers with their own matching loop against parsers that share `detail::erased_match`.
+#include <cstdio>
+#include <parser.hpp>
+#include <config_default.hpp>
+
+#ifndef ERASED
+#define ERASED 0
+#endif
+
+struct policy : cmd::default_policy {
+    static constexpr bool erased = ERASED;
+};
+
+constexpr cmd::config<int>::type add_config{
+    .name = "add",
+    .usages = {
+        {"add <path> [--force] [--dry-run]", 1}
+    }
+};
+constexpr cmd::config<int>::type commit_config{
+    .name = "commit",
+    .usages = {
+        {"commit [--message=<message>] [--amend]", 1}
+    }
+};
+constexpr cmd::config<int>::type push_config{
+    .name = "push",
+    .usages = {
+        {"push <remote> <branch> [--force]", 1},
+        {"push", 2}
+    }
+};
+constexpr cmd::config<int>::type pull_config{
+    .name = "pull",
+    .usages = {
+        {"pull <remote> (rebase|merge) [--verbose]", 1}
+    }
+};
+constexpr cmd::config<int>::type log_config{
+    .name = "log",
+    .usages = {
+        {"log ... [--oneline] [--max=<n>]", 1}
+    }
+};
+constexpr cmd::config<int>::type tag_config{
+    .name = "tag",
+    .usages = {
+        {"tag <name> [--delete]", 1},
+        {"tag list", 2}
+    }
+};
+constexpr cmd::config<int>::type stash_config{
+    .name = "stash",
+    .usages = {
+        {"stash (push|pop|list|drop)", 1}
+    }
+};
+constexpr cmd::config<int>::type remote_config{
+    .name = "remote",
+    .usages = {
+        {"remote add <name> <url>", 1},
+        {"remote remove <name>", 2}
+    }
+};
+constexpr cmd::config<int>::type branch_config{
+    .name = "branch",
+    .usages = {
+        {"branch <name> [--delete] [--move=<to>]", 1}
+    }
+};
+constexpr cmd::config<int>::type merge_config{
+    .name = "merge",
+    .usages = {
+        {"merge <branch> [--no-ff] [--squash]", 1}
+    }
+};
+constexpr cmd::config<int>::type rebase_config{
+    .name = "rebase",
+    .usages = {
+        {"rebase <upstream> [--onto=<base>] [--interactive]", 1}
+    }
+};
+constexpr cmd::config<int>::type config_config{
+    .name = "config",
+    .usages = {
+        {"config <key> <value>=(true|false|...) [--global]", 1}
+    }
+};
+
+constexpr auto add_info = cmd::define_parser<add_config>();
+constexpr auto commit_info = cmd::define_parser<commit_config>();
+constexpr auto push_info = cmd::define_parser<push_config>();
+constexpr auto pull_info = cmd::define_parser<pull_config>();
+constexpr auto log_info = cmd::define_parser<log_config>();
+constexpr auto tag_info = cmd::define_parser<tag_config>();
+constexpr auto stash_info = cmd::define_parser<stash_config>();
+constexpr auto remote_info = cmd::define_parser<remote_config>();
+constexpr auto branch_info = cmd::define_parser<branch_config>();
+constexpr auto merge_info = cmd::define_parser<merge_config>();
+constexpr auto rebase_info = cmd::define_parser<rebase_config>();
+constexpr auto config_info = cmd::define_parser<config_config>();
+
+template <const auto&... Infos>
+int run(int argc, char* argv[]) {
+    int matched = 0;
+    ((cmd::parser<Infos, policy>{}.parse(argc, argv) ? ++matched : 0), ...);
+    return matched;
+}
+
+int main(int argc, char* argv[]) {
+    std::printf("%d\n", run<
+        add_info, commit_info, push_info, pull_info, log_info, tag_info,
+        stash_info, remote_info, branch_info, merge_info, rebase_info, config_info
+    >(argc, argv));
+}
\ No newline at end of file
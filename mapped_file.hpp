@@ -0,0 +1,67 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cmd {
+    /// A read-only memory mapping of a whole file, e.g. for `compiled_tree::open` or a response file.
+    class mapped_file {
+        void* data_ = nullptr;
+        std::size_t size_ = 0;
+        dev_t device_ = 0;
+        ino_t inode_ = 0;
+    public:
+        /// \throw std::system_error if the file cannot be opened or mapped
+        explicit mapped_file(const char* path) {
+            const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::system_error(errno, std::system_category(), "open");
+            }
+            struct stat st;
+            if (fstat(fd, &st) < 0) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::system_category(), "fstat");
+            }
+            size_ = st.st_size;
+            device_ = st.st_dev;
+            inode_ = st.st_ino;
+            if (size_) {
+                data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data_ == MAP_FAILED) {
+                    const int error = errno;
+                    data_ = nullptr;
+                    ::close(fd);
+                    throw std::system_error(error, std::system_category(), "mmap");
+                }
+            }
+            ::close(fd);
+        }
+        mapped_file(mapped_file&& other) noexcept :
+            data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)},
+            device_{other.device_}, inode_{other.inode_} {}
+        mapped_file& operator=(mapped_file&& other) noexcept {
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(device_, other.device_);
+            std::swap(inode_, other.inode_);
+            return *this;
+        }
+        ~mapped_file() {
+            if (data_) munmap(data_, size_);
+        }
+        std::span<const std::byte> bytes() const noexcept {
+            return {static_cast<const std::byte*>(data_), size_};
+        }
+        /// \return whether both map the same file, whatever the paths they were opened with
+        bool same_file(const mapped_file& other) const noexcept {
+            return device_ == other.device_ && inode_ == other.inode_;
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <charconv>
+#include <iterator>
+#include <limits>
+#include "parser.hpp"
+
+namespace cmd {
+    /// Lock-free counters of parse outcomes and latencies, for use as `metrics_type` of a parser policy:
+    /// ```
+    /// struct policy : cmd::default_policy {
+    ///     using metrics_type = cmd::parse_metrics<info>;
+    /// };
+    /// ```
+    /// Counters are kept in `Shards` cache-line-aligned shards. Each thread updates only one shard
+    /// with relaxed atomics, and `snapshot` merges them.
+    /// \tparam Info: parser information from `define_parser`
+    /// \tparam Shards: number of shards
+    /// \remark All parsers with the same `Info` and `Shards` share the same counters.
+    template <tagged<parser_info_tag> auto& Info, std::size_t Shards = 16>
+    requires (Shards > 0)
+    class parse_metrics {
+    public:
+        using counter_type = std::uint64_t;
+        static constexpr std::size_t usages_n = Info.usages.size();
+        /// Bucket `i` counts parses that took [2^(i-1), 2^i) nanoseconds (bucket 0: less than 1ns).
+        /// The last bucket also counts everything slower.
+        static constexpr std::size_t latency_buckets = 40;
+
+        /// Merged values of all counters at some point in time.
+        struct snapshot_type {
+            /// Number of successful parses of each usage.
+            std::array<counter_type, usages_n> usages{};
+            /// Number of failed parses of each `error_type`.
+            std::array<counter_type, error_types_n> errors{};
+            /// Latency histogram of all parses, see `latency_buckets`.
+            std::array<counter_type, latency_buckets> latency{};
+
+            /// \return number of parses
+            constexpr counter_type total() const noexcept {
+                counter_type sum = 0;
+                for (counter_type n : latency) sum += n;
+                return sum;
+            }
+            /// \return upper bound (in nanoseconds) of the latency of `q` (in [0, 1]) of all parses
+            constexpr std::chrono::nanoseconds quantile(double q) const noexcept {
+                const counter_type total = this->total();
+                counter_type seen = 0;
+                for (std::size_t i = 0; i < latency_buckets; ++i) {
+                    seen += latency[i];
+                    if (seen && seen >= q * total) {
+                        return std::chrono::nanoseconds{std::int64_t{1} << i};
+                    }
+                }
+                return std::chrono::nanoseconds{std::int64_t{1} << (latency_buckets - 1)};
+            }
+            /// Writes the counters as a JSON object:
+            /// `{"usages":[...],"errors":[...],"latency_ns_log2":[...]}`,
+            /// where `usages` and `errors` are indexed by usage index and `error_type` respectively.
+            template <std::output_iterator<char> Out>
+            Out serialize(Out out) const {
+                auto write = [&out](std::string_view str) {
+                    out = ranges::copy(str, out).out;
+                };
+                auto write_array = [&out, &write](std::string_view key, const auto& counters, bool last) {
+                    write("\""); write(key); write("\":[");
+                    for (std::size_t i = 0; i < counters.size(); ++i) {
+                        char buffer[std::numeric_limits<counter_type>::digits10 + 1];
+                        if (i) write(",");
+                        write({buffer, std::to_chars(buffer, std::end(buffer), counters[i]).ptr});
+                    }
+                    write(last ? "]" : "],");
+                };
+                *out++ = '{';
+                write_array("usages", usages, false);
+                write_array("errors", errors, false);
+                write_array("latency_ns_log2", latency, true);
+                *out++ = '}';
+                return out;
+            }
+        };
+    private:
+        struct alignas(64) shard {
+            std::array<std::atomic<counter_type>, usages_n> usages{};
+            std::array<std::atomic<counter_type>, error_types_n> errors{};
+            std::array<std::atomic<counter_type>, latency_buckets> latency{};
+        };
+        static inline std::array<shard, Shards> shards_{};
+        static inline std::atomic<std::size_t> next_shard_{0};
+
+        static shard& local_shard() noexcept {
+            thread_local const std::size_t index = next_shard_.fetch_add(1, std::memory_order_relaxed) % Shards;
+            return shards_[index];
+        }
+        static void record_latency(shard& s, std::chrono::nanoseconds latency) noexcept {
+            const auto ns = static_cast<std::uint64_t>(latency.count() > 0 ? latency.count() : 0);
+            const std::size_t bucket = std::min<std::size_t>(std::bit_width(ns), latency_buckets - 1);
+            s.latency[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+    public:
+        /// Called by the parser after a successful parse.
+        static void record(std::size_t usage_index, std::chrono::nanoseconds latency) noexcept {
+            shard& s = local_shard();
+            s.usages[usage_index].fetch_add(1, std::memory_order_relaxed);
+            record_latency(s, latency);
+        }
+        /// Called by the parser after a failed parse.
+        static void record(error_type type, std::chrono::nanoseconds latency) noexcept {
+            shard& s = local_shard();
+            s.errors[std::to_underlying(type)].fetch_add(1, std::memory_order_relaxed);
+            record_latency(s, latency);
+        }
+        /// \return sum of all shards
+        /// \remark Parses that run concurrently may or may not be included.
+        static snapshot_type snapshot() noexcept {
+            snapshot_type res;
+            auto merge = [](auto& to, const auto& from) {
+                for (std::size_t i = 0; i < to.size(); ++i) {
+                    to[i] += from[i].load(std::memory_order_relaxed);
+                }
+            };
+            for (const shard& s : shards_) {
+                merge(res.usages, s.usages);
+                merge(res.errors, s.errors);
+                merge(res.latency, s.latency);
+            }
+            return res;
+        }
+        /// Sets all counters to 0.
+        static void reset() noexcept {
+            auto clear = [](auto& counters) {
+                for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+            };
+            for (shard& s : shards_) {
+                clear(s.usages);
+                clear(s.errors);
+                clear(s.latency);
+            }
+        }
+    };
+}
\ No newline at end of file
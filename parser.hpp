@@ -3,10 +3,24 @@
 #include <algorithm>
 #include <string>
 #include <bitset>
+#include <chrono>
 #include <vector>
+#include <memory>
+#include <memory_resource>
+#include <new>
 #include <expected>
 #include <iostream>
 #include <utility>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <charconv>
+#include <limits>
+#include <functional>
+#include <tuple>
 #include "common.hpp"
 #include "chartypes.hpp"
 #include "hash.hpp"
@@ -26,9 +40,12 @@ namespace cmd {
         flag_does_not_accept_argument,
         open_special_character,
         invalid_argument,
+        unreadable_response_file,
+        response_file_too_deep,
+        limit_exceeded,
         unknown_error
     };
-    constexpr std::size_t error_types_n = std::to_underlying(error_type::unknown_error) + 1;
+    inline constexpr std::size_t error_types_n = std::to_underlying(error_type::unknown_error) + 1;
 
     /// A concept that checks if T can be used to identify usages.
     /// Uniqueness is not required.
@@ -79,7 +96,23 @@ namespace cmd {
         CharT delimiter, enter, quote_open, quote_close, escape, indicator;
         std::basic_string_view<CharT> compound_open , compound_close, compound_divider,
             flag_open, flag_close, flag_prefix,
-            var_open, var_close, var_capture, equal, variadic;
+            var_open, var_close, var_capture, equal, variadic, delegate;
+        /// \remark `delegate` and `separator` were added later, so they come last:
+        /// positional initializers written before them keep their meaning.
+        CharT separator;
+    };
+    /// Limits on a command from untrusted input. A command that crosses one is rejected with
+    /// `error_type::limit_exceeded` as soon as it does, before it takes more memory.
+    /// By default, there is no limit.
+    struct input_limits {
+        /// Most characters in a command string, or most characters in all arguments of a range of arguments.
+        std::size_t command_size = -1;
+        /// Most arguments in a command.
+        std::size_t args = -1;
+        /// Most characters in an argument.
+        std::size_t arg_size = -1;
+        /// Most variadic arguments in a command.
+        std::size_t variadic = -1;
     };
     struct config_tag;
     /// Default values for `man_tmpl`, `error_tmpl`, `ref_tmpl`,
@@ -129,14 +162,19 @@ namespace cmd {
             /// Special characters in command parsing.
             special_chars<char_type> specials = config_default_type::specials;
             /// Order corresponds to order of enums in `error_type`.
+            /// Every message but that of `unknown_error` must be non-empty, which `define_parser` checks.
             std::array<format_string_view_type, error_types_n> error_msgs = config_default_type::error_msgs;
+            /// Limits on commands, which are checked while they are split into arguments and matched.
+            input_limits limits{};
         };
     };
     template <typename T>
     concept config_instance = tagged<typename T::super_type, config_tag>;
 
     enum class parse_node_type {
-        option, variable, variable_option, variadic, end
+        option, variable, variable_option, variadic, end,
+        /// Ends a usage, leaving the remaining arguments to another parser.
+        delegate
     };
     /// A node in a parse tree.
     /// \tparam CharT: input character type
@@ -149,9 +187,11 @@ namespace cmd {
         union {
             /// Only applicable when `type` is `variable` or `variable_option`.
             std::size_t var_index = 0;
-            /// Only applicable when `type` is `end`.
+            /// Only applicable when `type` is `variadic`, `end` or `delegate`.
             std::size_t usage_index;
         };
+        /// Only applicable when `type` is `variable_option`: index of the option among those declared with it.
+        std::size_t choice_index = 0;
         /// Index of the next node in the same position. A value of 0 means there is no such node.
         std::size_t next_placeholder = 0;
         /// Index of the first node in the next position. A value of 0 means there is no such node.
@@ -179,9 +219,15 @@ namespace cmd {
     };
     /// \return hash of str (by hasher `Hash`) in a set of size `SetSize`
     template <typename Hash, std::size_t SetSize>
-    static constexpr std::size_t get_hash(auto str) noexcept {
+    constexpr std::size_t get_hash(auto str) noexcept {
         return Hash{}(str) % SetSize;
     }
+    /// \return slot of variable `str` (hashed by hasher `Hash`) in a table of size `table_size` (a power of 2),
+    /// where `multiplier` is chosen by `define_parser` so that no two variables share a slot
+    template <typename Hash>
+    constexpr std::size_t get_var_slot(auto str, std::uint64_t multiplier, std::size_t table_size) noexcept {
+        return static_cast<std::size_t>(std::uint64_t{Hash{}(str)} * multiplier >> 32) & (table_size - 1);
+    }
 
     struct parser_def_tag;
     /// Definition of a parser.
@@ -190,7 +236,9 @@ namespace cmd {
     struct parser_def {
         using tag = parser_def_tag;
         using config_type = Config::super_type;
-        std::size_t usage_size, tree_size, vars_size, flag_set_size, var_num;
+        std::size_t usage_size, tree_size, vars_size, flag_set_size, var_num, var_table_size;
+        /// Multiplier of `get_var_slot`.
+        std::uint64_t var_hash_multiplier;
         const Config& config;
     };
 
@@ -211,6 +259,10 @@ namespace cmd {
         std::array<parse_node<char_type>, Def.tree_size> tree;
         std::array<string_view_type, Def.vars_size> var_names;
         std::array<flag_info<Def.usage_size, char_type>, Def.flag_set_size> flag_set;
+        /// Perfect hash set of variables by `get_var_slot`: index in `var_names`, or 0 for an empty slot.
+        std::array<std::size_t, Def.var_table_size> var_table;
+        /// Index of each node in the tree built without a profile, which indexes a profile.
+        std::array<std::size_t, Def.tree_size> node_origin;
     };
 
     /// Location of an error in a command.
@@ -240,11 +292,546 @@ namespace cmd {
         Args& args;
         constexpr receiver(Args& args) noexcept : args{args} {}
     };
+    /// A view of the arguments in one contiguous buffer, each followed by `separator`,
+    /// e.g. `/proc/<pid>/cmdline` or the output of `find -print0`.
+    /// The separator after the last argument is optional.
+    /// Arguments are found lazily with `CharTraits::find` (i.e. `memchr` for `char`),
+    /// so no vector of arguments is built.
+    template <char_like CharT, typename CharTraits = std::char_traits<CharT>>
+    class delimited_range : public ranges::view_interface<delimited_range<CharT, CharTraits>> {
+    public:
+        using string_view_type = std::basic_string_view<CharT, CharTraits>;
+        class iterator {
+            const CharT *current_ = nullptr, *end_ = nullptr;
+            /// \internal Size of the argument at `current_`.
+            std::size_t size_ = 0;
+            CharT separator_{};
+
+            constexpr void find() noexcept {
+                const CharT* found = CharTraits::find(current_, end_ - current_, separator_);
+                size_ = (found ? found : end_) - current_;
+            }
+        public:
+            using value_type = string_view_type;
+            using difference_type = std::ptrdiff_t;
+            using iterator_concept = std::forward_iterator_tag;
+
+            constexpr iterator() noexcept = default;
+            constexpr iterator(const CharT* begin, const CharT* end, CharT separator) noexcept :
+                current_{begin}, end_{end}, separator_{separator} {
+                if (current_ != end_) find();
+            }
+            constexpr value_type operator*() const noexcept {
+                return {current_, size_};
+            }
+            constexpr iterator& operator++() noexcept {
+                current_ += size_;
+                if (current_ != end_) {
+                    ++current_;
+                    if (current_ != end_) find();
+                }
+                return *this;
+            }
+            constexpr iterator operator++(int) noexcept {
+                iterator old = *this;
+                ++*this;
+                return old;
+            }
+            constexpr bool operator==(const iterator& other) const noexcept {
+                return current_ == other.current_;
+            }
+        };
+
+        constexpr delimited_range() noexcept = default;
+        /// \param buffer: arguments, which must outlive the range
+        /// \param separator: character after each argument
+        constexpr delimited_range(string_view_type buffer, CharT separator) noexcept :
+            buffer_{buffer}, separator_{separator} {}
+        constexpr iterator begin() const noexcept {
+            return {buffer_.data(), buffer_.data() + buffer_.size(), separator_};
+        }
+        constexpr iterator end() const noexcept {
+            const CharT* end = buffer_.data() + buffer_.size();
+            return {end, end, separator_};
+        }
+    private:
+        string_view_type buffer_;
+        CharT separator_{};
+    };
+    /// `metrics_type` of a `parser` that records nothing.
+    struct no_metrics {};
+    /// `response_files_type` of a `parser` that takes all arguments verbatim.
+    struct no_response_files {};
+    /// Steps of `parser::parse` reported to `tracer_type`.
+    enum class trace_event {
+        /// `node` is about to be matched against argument `arg`.
+        node_visit,
+        /// Argument `arg` did not match, so `parse` moves on to the next alternative `node`.
+        placeholder_hop,
+        /// Argument `arg` is stored in the variable of `node`.
+        var_capture,
+        /// Argument `arg` is looked up as a flag of the usage ending at `node`.
+        flag_lookup,
+        /// The flag is hashed to slot `node` of `flag_set` (not an index of `tree`).
+        hash_probe
+    };
+    inline constexpr std::size_t trace_events_n = std::to_underlying(trace_event::hash_probe) + 1;
+    /// `tracer_type` of a `parser` that traces nothing.
+    struct no_tracer {};
+
+    namespace detail {
+        /// The loop that matches arguments against a parse tree, shared by `parser` and `runtime_parser`.
+        struct matcher {
+            /// \param tree: provides `specials()`, `node(i)`, `flag_slot(name)`,
+            /// `flag_defined(slot, name, usage_index)` and `flag_var_index(slot, usage_index)`,
+            /// and optionally `limits()` (an `input_limits`)
+            /// \param state: the parser, which receives captures, flags, variadic arguments and trace events.
+            /// `push_variadic(arg)` may reject `arg` by returning the position of an invalid character,
+            /// which fails the match with `error_type::invalid_argument`.
+            /// \param raise: makes the return value on failure from
+            /// `(error_type, index of the first node of the position, error_loc)`
+            /// \param succeed: makes the return value on success from the usage index
+            /// and the index of the first argument left to another parser (see `parse_node_type::delegate`)
+            template <typename Tree, typename State, typename Args, typename Raise, typename Succeed>
+            static constexpr auto match(const Tree& tree, State& state, Args& args, Raise& raise, Succeed& succeed) {
+                using enum parse_node_type;
+                using enum error_type;
+                using string_view_type = Tree::string_view_type;
+                using iter_type = ranges::iterator_t<Args>;
+                using sentinel_type = ranges::sentinel_t<Args>;
+                const auto& specials = tree.specials();
+                constexpr input_limits no_limits{};
+                const input_limits& limits = [&tree, &no_limits] -> const input_limits& {
+                    if constexpr (requires {tree.limits();}) {
+                        return tree.limits();
+                    } else {
+                        return no_limits;
+                    }
+                }();
+                std::size_t node_index = 0, start_node = 0;
+                auto arg_current = ranges::begin(args);
+                auto arg_end = ranges::end(args);
+                std::size_t arg_loc = 0;
+                auto next_arg = [&arg_current, &arg_loc]() {
+                    ++arg_current; ++arg_loc;
+                };
+                auto next_arg_node = [&start_node, &node_index, next_arg](std::size_t next_node_idx) {
+                    start_node = node_index = next_node_idx;
+                    next_arg();
+                };
+                auto fail = [&raise, &start_node, &arg_loc](error_type err, std::size_t in_arg_loc = 0) {
+                    return raise(err, start_node, error_loc{arg_loc, in_arg_loc});
+                };
+                // the same argument may be read again after a node is reached, but it is counted once
+                std::size_t command_size = 0, checked_loc = -1;
+                auto within_limits = [&limits, &arg_loc, &command_size, &checked_loc](string_view_type arg) {
+                    if (arg_loc == checked_loc) return true;
+                    checked_loc = arg_loc;
+                    command_size += arg.size();
+                    return arg_loc < limits.args && arg.size() <= limits.arg_size
+                        && command_size <= limits.command_size;
+                };
+                string_view_type arg;
+                while (true) {
+                    if (arg_current == arg_end) [[unlikely]] {
+                        while (tree.node(node_index).next_placeholder) {
+                            node_index = tree.node(node_index).next_placeholder;
+                            state.trace(trace_event::placeholder_hop, node_index, arg_loc);
+                        }
+                        const parse_node_type type = tree.node(node_index).type;
+                        if (type != variadic && type != end && type != delegate) {
+                            return fail(too_few_arguments);
+                        }
+                    } else {
+                        arg = *arg_current;
+                        if (!within_limits(arg)) [[unlikely]] return fail(limit_exceeded);
+                    }
+                    parse_arg:
+                    state.trace(trace_event::node_visit, node_index, arg_loc);
+                    const auto& node = tree.node(node_index);
+                    switch (node.type) {
+                        case option:
+                        case variable_option: {
+                            if (node.option_name == arg) {
+                                if (node.type == variable_option) {
+                                    state.trace(trace_event::var_capture, node_index, arg_loc);
+                                    state.capture(node.var_index, arg, {arg_loc, 0});
+                                    state.choose(node.var_index, node.choice_index);
+                                }
+                                next_arg_node(node.next);
+                            } else if (node.next_placeholder) {
+                                node_index = node.next_placeholder;
+                                state.trace(trace_event::placeholder_hop, node_index, arg_loc);
+                                if !consteval {goto parse_arg;}
+                            } else [[unlikely]] {
+                                return fail(unknown_option);
+                            }
+                            continue;
+                        }
+                        case variable: {
+                            if (arg.starts_with(specials.flag_prefix)) {
+                                return fail(flag_cannot_be_variable);
+                            }
+                            state.trace(trace_event::var_capture, node_index, arg_loc);
+                            state.capture(node.var_index, arg, {arg_loc, 0});
+                            next_arg_node(node.next);
+                            continue;
+                        }
+                        case variadic: {
+                            state.capture(0, {}, {arg_loc, 0});
+                            if constexpr (std::sized_sentinel_for<iter_type, sentinel_type>) {
+                                state.reserve_variadic(
+                                    std::min(static_cast<std::size_t>(arg_end - arg_current), limits.variadic));
+                            } else if constexpr (ranges::sized_range<Args>) {
+                                state.reserve_variadic(
+                                    std::min(static_cast<std::size_t>(ranges::size(args)), limits.variadic));
+                            }
+                            for (std::size_t variadic_size = 0; arg_current != arg_end; next_arg()) {
+                                arg = *arg_current;
+                                if (!within_limits(arg)) [[unlikely]] return fail(limit_exceeded);
+                                if (arg.starts_with(specials.flag_prefix)) break;
+                                if (++variadic_size > limits.variadic) [[unlikely]] return fail(limit_exceeded);
+                                state.trace(trace_event::var_capture, node_index, arg_loc);
+                                if (const auto pos = state.push_variadic(arg)) [[unlikely]] {
+                                    return fail(invalid_argument, *pos);
+                                }
+                            }
+                            break;
+                        }
+                        case end: {
+                            break;
+                        }
+                        case delegate: {
+                            return succeed(node.usage_index, arg_loc);
+                        }
+                    }
+                    break;
+                }
+                const std::size_t usage_index = tree.node(node_index).usage_index;
+                for (;arg_current != arg_end; next_arg()) {
+                    string_view_type flag_str = *arg_current;
+                    if (!within_limits(flag_str)) [[unlikely]] return fail(limit_exceeded);
+                    if (flag_str.starts_with(specials.flag_prefix)) [[likely]] {
+                        state.trace(trace_event::flag_lookup, node_index, arg_loc);
+                        const std::size_t eq_pos = flag_str.find(specials.equal);
+                        string_view_type flag_name = flag_str.substr(0, eq_pos);
+                        const std::size_t h = tree.flag_slot(flag_name);
+                        state.trace(trace_event::hash_probe, h, arg_loc);
+                        if (tree.flag_defined(h, flag_name, usage_index)) [[likely]] {
+                            state.flags_[h] = true;
+                            if (eq_pos != flag_str.npos) {
+                                if (std::size_t var_index = tree.flag_var_index(h, usage_index)) [[likely]] {
+                                    state.trace(trace_event::var_capture, node_index, arg_loc);
+                                    state.capture(var_index,
+                                        flag_str.substr(eq_pos + specials.equal.size()), {arg_loc, eq_pos + 1});
+                                } else {
+                                    return fail(flag_does_not_accept_argument, eq_pos);
+                                }
+                            }
+                        } else {
+                            return fail(unknown_flag);
+                        }
+                    } else {
+                        return fail(too_many_arguments);
+                    }
+                }
+                return succeed(usage_index, arg_loc);
+            }
+        };
+
+        /// \param tree: nodes of a parse tree
+        /// \param node_loc: index of the first node of the position where a parse fails
+        /// \param queue, visited: scratch space, both of the size of `tree`
+        /// \param out: receives the indices of the usages reachable from `node_loc`
+        /// \return number of indices written to `out`
+        template <char_like CharT>
+        constexpr std::size_t related_usages(std::span<const parse_node<CharT>> tree, std::size_t node_loc,
+                                             std::span<std::size_t> queue, std::span<bool> visited,
+                                             std::span<std::size_t> out) noexcept {
+            using enum parse_node_type;
+            std::size_t front = 0, back = 1, count = 0;
+            queue[front] = node_loc;
+            auto push = [&queue, &back, &visited](std::size_t node_idx) {
+                if (!visited[node_idx]) {
+                    queue[back++] = node_idx;
+                    visited[node_idx] = true;
+                }
+            };
+            while (front != back) {
+                const auto& node = tree[queue[front]];
+                switch (node.type) {
+                    case option:
+                    case variable_option: {
+                        push(node.next);
+                        std::size_t next_option = node.next_placeholder;
+                        if (next_option) {
+                            queue[front] = next_option;
+                            continue;
+                        }
+                        break;
+                    }
+                    case variable:
+                        push(node.next);
+                        break;
+                    case end:
+                    case delegate:
+                        if (count < out.size()) out[count++] = node.usage_index;
+                        break;
+                }
+                ++front;
+            }
+            return count;
+        }
+
+        /// A parse tree for `matcher`, without the type of its `parser_info`. See `erased_match`.
+        template <typename StringView>
+        struct erased_tree {
+            using string_view_type = StringView;
+            using char_type = StringView::value_type;
+            const special_chars<char_type>* specials_;
+            const input_limits* limits_;
+            std::span<const parse_node<char_type>> nodes_;
+            std::size_t (*flag_slot_)(string_view_type) noexcept;
+            bool (*flag_defined_)(std::size_t, string_view_type, std::size_t) noexcept;
+            std::size_t (*flag_var_index_)(std::size_t, std::size_t) noexcept;
+
+            const special_chars<char_type>& specials() const noexcept {
+                return *specials_;
+            }
+            const input_limits& limits() const noexcept {
+                return *limits_;
+            }
+            const parse_node<char_type>& node(std::size_t i) const noexcept {
+                return nodes_[i];
+            }
+            std::size_t flag_slot(string_view_type name) const noexcept {
+                return flag_slot_(name);
+            }
+            bool flag_defined(std::size_t slot, string_view_type name, std::size_t usage_index) const noexcept {
+                return flag_defined_(slot, name, usage_index);
+            }
+            std::size_t flag_var_index(std::size_t slot, std::size_t usage_index) const noexcept {
+                return flag_var_index_(slot, usage_index);
+            }
+        };
+        /// A parser for `matcher` to write to, without the type of the parser. See `erased_match`.
+        template <typename StringView>
+        struct erased_state {
+            void* self;
+            void (*capture_)(void*, std::size_t, StringView, error_loc);
+            void (*choose_)(void*, std::size_t, std::size_t) noexcept;
+            void (*set_flag_)(void*, std::size_t) noexcept;
+            std::optional<std::size_t> (*push_variadic_)(void*, StringView);
+            /// \internal `nullptr` for `no_tracer`.
+            void (*trace_)(void*, trace_event, std::size_t, std::size_t);
+
+            /// \internal Stands for `flags_` of a parser, so that `flags_[slot] = true` sets a flag.
+            struct flags_type {
+                erased_state& state;
+                struct reference {
+                    erased_state& state;
+                    std::size_t slot;
+                    void operator=(bool value) const noexcept {
+                        if (value) state.set_flag_(state.self, slot);
+                    }
+                };
+                reference operator[](std::size_t slot) const noexcept {
+                    return {state, slot};
+                }
+            } flags_{*this};
+
+            void capture(std::size_t var_index, StringView value, error_loc loc) {
+                capture_(self, var_index, value, loc);
+            }
+            void choose(std::size_t var_index, std::size_t choice_index) noexcept {
+                choose_(self, var_index, choice_index);
+            }
+            void reserve_variadic(std::size_t) const noexcept {}
+            std::optional<std::size_t> push_variadic(StringView arg) {
+                return push_variadic_(self, arg);
+            }
+            void trace(trace_event event, std::size_t node, std::size_t arg) {
+                if (trace_) trace_(self, event, node, arg);
+            }
+        };
+        /// Arguments for `matcher`, without the type of their range.
+        template <typename StringView>
+        class erased_args {
+            void* current_;
+            const void* end_;
+            bool (*done_)(const void*, const void*);
+            void (*next_)(void*);
+            StringView (*get_)(const void*);
+        public:
+            /// \param current, end: iterator and sentinel of the arguments, which must outlive `erased_args`
+            template <typename Iter, typename Sentinel>
+            erased_args(Iter& current, const Sentinel& end) noexcept :
+                current_{&current}, end_{&end},
+                done_{[](const void* it, const void* end) {
+                    return *static_cast<const Iter*>(it) == *static_cast<const Sentinel*>(end);
+                }},
+                next_{[](void* it) {++*static_cast<Iter*>(it);}},
+                get_{[](const void* it) -> StringView {return **static_cast<const Iter*>(it);}} {}
+
+            class iterator {
+                erased_args* args_ = nullptr;
+            public:
+                using value_type = StringView;
+                using difference_type = std::ptrdiff_t;
+
+                iterator() noexcept = default;
+                explicit iterator(erased_args* args) noexcept : args_{args} {}
+                StringView operator*() const {
+                    return args_->get_(args_->current_);
+                }
+                iterator& operator++() {
+                    args_->next_(args_->current_);
+                    return *this;
+                }
+                void operator++(int) {
+                    ++*this;
+                }
+                bool operator==(std::default_sentinel_t) const {
+                    return args_->done_(args_->current_, args_->end_);
+                }
+            };
+            iterator begin() noexcept {
+                return iterator{this};
+            }
+            std::default_sentinel_t end() const noexcept {
+                return {};
+            }
+        };
+        /// Outcome of `erased_match`, from which `parser` makes its return value.
+        struct erased_outcome {
+            /// `std::nullopt` on success.
+            std::optional<error_type> error;
+            std::size_t start_node = 0;
+            error_loc loc;
+            std::size_t usage_index = 0, rest_loc = 0;
+        };
+        /// `matcher::match` on type-erased arguments. It is instantiated once for each `StringView`,
+        /// however many parsers use it, instead of once for each `parser_info` and type of arguments.
+        template <typename StringView>
+        erased_outcome erased_match(const erased_tree<StringView>& tree, erased_state<StringView>& state,
+                                    erased_args<StringView>& args) {
+            auto raise = [](error_type err, std::size_t start_node, error_loc loc) {
+                return erased_outcome{.error = err, .start_node = start_node, .loc = loc, .usage_index = 0, .rest_loc = 0};
+            };
+            auto succeed = [](std::size_t usage_index, std::size_t rest_loc) {
+                return erased_outcome{
+                    .error = std::nullopt, .start_node = 0, .loc = {}, .usage_index = usage_index, .rest_loc = rest_loc
+                };
+            };
+            return matcher::match(tree, state, args, raise, succeed);
+        }
+
+        /// \param chunk: 8 characters loaded in little-endian order
+        /// \return whether all characters in `chunk` are decimal digits
+        constexpr bool all_digits(std::uint64_t chunk) noexcept {
+            return ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+                == 0x3333333333333333;
+        }
+        /// \param chunk: 8 decimal digits loaded in little-endian order
+        /// \return value of the digits, the first being the most significant
+        constexpr std::uint32_t digits_value(std::uint64_t chunk) noexcept {
+            chunk = (chunk & 0x0F0F0F0F0F0F0F0F) * 2561 >> 8;
+            chunk = (chunk & 0x00FF00FF00FF00FF) * 6553601 >> 16;
+            return static_cast<std::uint32_t>((chunk & 0x0000FFFF0000FFFF) * 42949672960001 >> 32);
+        }
+        /// Converts `str` to `value`. Up to 16 digits without a sign are validated and converted
+        /// 8 characters at a time; everything else (signs, floating-point numbers, longer numbers, errors)
+        /// goes through `std::from_chars`.
+        /// \return index of the first invalid character in `str` (0 if it is out of range),
+        /// or `std::nullopt` on success
+        template <typename T>
+        std::optional<std::size_t> parse_number(std::string_view str, T& value) noexcept {
+            if constexpr (std::integral<T> && std::endian::native == std::endian::little) {
+                if (!str.empty() && str.size() <= 16) {
+                    // right-aligned, so that leading '0's do not change the value
+                    char digits[16];
+                    std::memset(digits, '0', 16);
+                    std::memcpy(digits + 16 - str.size(), str.data(), str.size());
+                    std::uint64_t high, low;
+                    std::memcpy(&high, digits, 8);
+                    std::memcpy(&low, digits + 8, 8);
+                    if (all_digits(high) && all_digits(low)) [[likely]] {
+                        const std::uint64_t n = digits_value(high) * 100'000'000ull + digits_value(low);
+                        if (n <= static_cast<std::uint64_t>(std::numeric_limits<T>::max())) [[likely]] {
+                            value = static_cast<T>(n);
+                            return std::nullopt;
+                        }
+                    }
+                }
+            }
+            const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+            if (ec != std::errc{}) return 0;
+            if (ptr != str.data() + str.size()) return ptr - str.data();
+            return std::nullopt;
+        }
+        /// Same as `parse_number(std::string_view, T&)`, for any character type.
+        /// Characters beyond ASCII are invalid.
+        template <typename T, std::integral CharT, typename CharTraits>
+        std::optional<std::size_t> parse_number(std::basic_string_view<CharT, CharTraits> str, T& value) {
+            if constexpr (std::same_as<CharT, char>) {
+                return parse_number(std::string_view{str.data(), str.size()}, value);
+            } else {
+                auto narrow = [&str, &value](char* out) -> std::optional<std::size_t> {
+                    for (std::size_t i = 0; i < str.size(); ++i) {
+                        const auto c = static_cast<std::make_unsigned_t<CharT>>(str[i]);
+                        if (c > 0x7F) return i;
+                        out[i] = static_cast<char>(c);
+                    }
+                    return parse_number(std::string_view{out, str.size()}, value);
+                };
+                if (char buffer[64]; str.size() <= std::size(buffer)) return narrow(buffer);
+                std::string buffer(str.size(), '\0');
+                return narrow(buffer.data());
+            }
+        }
+    }
+    /// Compile-time customization of a `parser`.
+    /// To customize, derive from this struct and hide the members to be changed.
+    struct default_policy {
+        /// Allocator for all dynamic memory of a `parser` and of the objects it returns.
+        /// It is rebound to each element type.
+        template <typename T>
+        using allocator_type = std::allocator<T>;
+        /// Receives the outcome and latency of every parse through its static member functions
+        /// `record(std::size_t usage_index, std::chrono::nanoseconds)` and
+        /// `record(error_type, std::chrono::nanoseconds)`. See `parse_metrics` in `metrics.hpp`.
+        using metrics_type = no_metrics;
+        /// Called as `tracer(trace_event, std::size_t node, std::size_t arg)` at each step of a parse,
+        /// where `node` is an index of `tree` and `arg` is an index of the arguments.
+        /// A `parser` owns one instance, see `parser::tracer()`. See `trace.hpp` for tracers.
+        using tracer_type = no_tracer;
+        /// Expands response files (`@file` arguments) given to `parse(Args&&)` and `parse(argc, argv)`
+        /// through its static member function `expand(Args&&, const special_chars<char_type>&)`.
+        /// See `response_files` in `response.hpp`.
+        using response_files_type = no_response_files;
+        /// Whether `parse` goes through `detail::erased_match`, which is shared by all parsers of the same
+        /// `char_type`, instead of a matching loop specialized for each `parser_info` and type of arguments.
+        /// This reduces code size when there are many parsers, at the cost of indirect calls.
+        static constexpr bool erased = false;
+    };
+    namespace detail {
+        /// `Policy` without its parts that only work at runtime, for a `parser` used in constant evaluation:
+        /// allocators such as `std::pmr`'s, metrics, tracers and response files.
+        /// Its parses have the same outcome as those of `Policy`.
+        template <typename Policy>
+        struct constant_policy : Policy {
+            template <typename T>
+            using allocator_type = std::allocator<T>;
+            using metrics_type = no_metrics;
+            using tracer_type = no_tracer;
+            using response_files_type = no_response_files;
+        };
+    }
     struct error_ref_c_tag;
     struct error_ref_tag;
     struct error_tag;
     struct parse_result_tag;
-    template <tagged<parser_info_tag> auto& Info>
+    template <tagged<parser_info_tag> auto& Info, typename Policy = default_policy>
     class parser {
     public:
         static constexpr const auto& info = Info;
@@ -256,14 +843,24 @@ namespace cmd {
         using result_type = config_type::result_type;
         using char_type = config_type::char_type;
         using char_traits_type = config_type::char_traits_type;
-        using string_type = std::basic_string<char_type, char_traits_type>;
         using string_view_type = config_type::string_view_type;
         using format_char_type = config_type::format_char_type;
         using format_char_traits_type = config_type::format_char_traits_type;
         using format_string_type = std::basic_string<format_char_type, format_char_traits_type>;
         using format_string_view_type = config_type::format_string_view_type;
         using hash_type = info_type::hash_type;
-        using refs_type = std::vector<const typename config_type::usage_type*>;
+        using policy_type = Policy;
+        using metrics_type = Policy::metrics_type;
+        using tracer_type = Policy::tracer_type;
+        template <typename T>
+        using allocator_for = Policy::template allocator_type<T>;
+        using allocator_type = allocator_for<char_type>;
+        using string_type = std::basic_string<char_type, char_traits_type, allocator_type>;
+        /// Type of the vector of arguments created by `parse(const Str&)`.
+        using args_type = std::vector<string_type, allocator_for<string_type>>;
+        using variadic_type = std::vector<string_type, allocator_for<string_type>>;
+        using refs_type = std::vector<const typename config_type::usage_type*,
+            allocator_for<const typename config_type::usage_type*>>;
         using usage_range_type = detail::usage_range<config.usage_tmpl>;
         static constexpr auto input_stream = input_object<char_type>::value;
         static constexpr auto output_stream = output_object<format_char_type>::value;
@@ -273,6 +870,10 @@ namespace cmd {
         /// This is because the `index` is computed at compile time from variable name.
         struct var_name {
             std::size_t index;
+        private:
+            friend parser;
+            explicit constexpr var_name(std::size_t index) noexcept : index{index} {}
+        public:
             consteval var_name(const char_type* name) {
                 for (auto [i, var_name] : Info.var_names | views::enumerate) {
                     if (name == var_name) {
@@ -287,6 +888,10 @@ namespace cmd {
         /// This is because the `index` is computed at compile time from flag name.
         struct flag_name {
             std::size_t index;
+        private:
+            friend parser;
+            explicit constexpr flag_name(std::size_t index) noexcept : index{index} {}
+        public:
             consteval flag_name(const char_type* name) {
                 const std::size_t h = get_hash<hash_type, Info.flag_set.size()>(name);
                 if (name == Info.flag_set[h].name) [[likely]] {
@@ -300,12 +905,103 @@ namespace cmd {
         struct vars_element {
             string_type content{};
             error_loc loc{};
+            /// Index of the option that matched, or -1 if none did.
+            std::size_t choice = -1;
         };
-        /// \internal Index 0: variadic argument.\n Index 1 onwards: variables.
-        std::array<vars_element, Info.var_names.size()> vars_{};
+        using vars_type = std::array<vars_element, Info.var_names.size()>;
+        /// \internal Index 0: variadic argument (its `loc` is that of the first variadic argument).\n
+        /// Index 1 onwards: variables.
+        vars_type vars_{};
         std::bitset<Info.flag_set.size()> flags_{};
-        std::vector<string_type> variadic_{};
+        variadic_type variadic_{};
+        /// \internal Converts variadic arguments during `match` instead of storing them in `variadic_`.
+        /// Set only by `parse(Input&&, std::vector<T, Alloc>&, format_string_view_type)`.
+        struct variadic_sink {
+            void* out = nullptr;
+            void (*reserve)(void*, std::size_t) = nullptr;
+            /// \return position of the first invalid character of the argument, or `std::nullopt`
+            std::optional<std::size_t> (*push)(void*, string_view_type) = nullptr;
+        } variadic_sink_{};
+        [[no_unique_address]] allocator_type allocator_{};
+        [[no_unique_address]] tracer_type tracer_{};
+
+        static constexpr vars_type make_vars(const allocator_type& alloc) {
+            return [&alloc]<std::size_t... I>(std::index_sequence<I...>) {
+                return vars_type{((void)I, vars_element{string_type(alloc), {}, -1uz})...};
+            }(std::make_index_sequence<Info.var_names.size()>{});
+        }
+        /// Stores `value` in variable no. `var_index`, reusing its buffer.
+        constexpr void capture(std::size_t var_index, string_view_type value, error_loc loc) {
+            vars_[var_index].content.assign(value);
+            vars_[var_index].loc = loc;
+        }
+        /// Records that variable no. `var_index` was matched by its option no. `choice_index`.
+        constexpr void choose(std::size_t var_index, std::size_t choice_index) noexcept {
+            vars_[var_index].choice = choice_index;
+        }
+        constexpr void reserve_variadic(std::size_t size) {
+            if (variadic_sink_.out) {
+                variadic_sink_.reserve(variadic_sink_.out, size);
+            } else {
+                variadic_.reserve(size);
+            }
+        }
+        /// Appends a variadic argument, or hands it to `variadic_sink_` if one is set.
+        constexpr std::optional<std::size_t> push_variadic(string_view_type arg) {
+            if (variadic_sink_.out) return variadic_sink_.push(variadic_sink_.out, arg);
+            variadic_.emplace_back(arg);
+            return std::nullopt;
+        }
+        /// \internal Access to `Info` for `detail::matcher`.
+        struct tree_access {
+            using string_view_type = parser::string_view_type;
+            static constexpr const auto& specials() noexcept {
+                return config.specials;
+            }
+            static constexpr const input_limits& limits() noexcept {
+                return config.limits;
+            }
+            static constexpr const auto& node(std::size_t i) noexcept {
+                return Info.tree[i];
+            }
+            static constexpr std::size_t flag_slot(string_view_type name) noexcept {
+                return get_hash<hash_type, Info.flag_set.size()>(name);
+            }
+            static constexpr bool flag_defined(
+                std::size_t slot, string_view_type name, std::size_t usage_index) noexcept {
+                const auto& flag = Info.flag_set[slot];
+                return flag.name == name && flag.defined_for[usage_index];
+            }
+            static constexpr std::size_t flag_var_index(std::size_t slot, std::size_t usage_index) noexcept {
+                return Info.flag_set[slot].var_index_for[usage_index];
+            }
+        };
+        /// \internal `tree_access` for `detail::erased_match`.
+        static constexpr detail::erased_tree<string_view_type> erased_tree{
+            &config.specials, &config.limits, Info.tree,
+            &tree_access::flag_slot, &tree_access::flag_defined, &tree_access::flag_var_index
+        };
+        friend detail::matcher;
+        /// Reports a step of `match` to `tracer_`. Nothing is emitted for `no_tracer`.
+        constexpr void trace(trace_event event, std::size_t node, std::size_t arg) {
+            if constexpr (!std::same_as<tracer_type, no_tracer>) {
+                tracer_(event, node, arg);
+            }
+        }
     public:
+        constexpr parser() noexcept = default;
+        /// \param alloc: allocator for variables, arguments and errors
+        explicit constexpr parser(const allocator_type& alloc) :
+            vars_{make_vars(alloc)}, variadic_(alloc), allocator_{alloc} {}
+        constexpr allocator_type get_allocator() const noexcept {
+            return allocator_;
+        }
+        constexpr tracer_type& tracer() noexcept {
+            return tracer_;
+        }
+        constexpr const tracer_type& tracer() const noexcept {
+            return tracer_;
+        }
         /// A wrapper for `error_ref` for `std::formatter`.
         /// \tparam Mode: 0 - prints the command (`ref`)\n
         /// 1 - prints an indicator (^) at the location of the error
@@ -350,6 +1046,9 @@ namespace cmd {
         template <typename Args>
         struct parse_error : part_parse_error {
             error_ref<Args> ref;
+            /// Message after `error_type::invalid_argument` for a variadic argument rejected by
+            /// `parse(Input&&, std::vector<T, Alloc>&, format_string_view_type)`; empty otherwise.
+            format_string_view_type what{};
             /// Make a `parse_error` whose location cannot be pinpointed
             /// \param type: error type
             /// \param args: an `forward_range` of arguments that form the command
@@ -367,7 +1066,7 @@ namespace cmd {
             requires outputtable {
                 return std::format_to(
                     out, config.error_tmpl, config.error_msgs[std::to_underlying(this->type)],
-                    ref, typename usage_range_type::type{this->refs}, format_string_view_type{});
+                    ref, typename usage_range_type::type{this->refs}, what);
             }
             auto print() const
             requires (!!output_stream && outputtable) {
@@ -410,181 +1109,136 @@ namespace cmd {
             using super_type = parser;
             result_type result;
             std::size_t usage_index;
+            /// Index of the first argument left to another parser by a usage ending with `specials.delegate`.
+            /// For other usages, it is the number of arguments.
+            std::size_t rest_loc;
         };
         /// Result of a successful `parse`.
         template <typename Args>
         requires RANGE_OF(Args, forward_range, string_view_type)
         struct parse_result : part_parse_result, receiver<Args> {
-            constexpr parse_result(result_type result, std::size_t usage_index, Args&& args) :
-                part_parse_result{result, usage_index}, receiver<Args>{std::forward<Args>(args)} {}
+            constexpr parse_result(result_type result, std::size_t usage_index, std::size_t rest_loc, Args&& args) :
+                part_parse_result{result, usage_index, rest_loc}, receiver<Args>{std::forward<Args>(args)} {}
+            /// \return arguments left to another parser, which is empty unless the usage ends with
+            /// `specials.delegate`
+            constexpr auto rest() const noexcept {
+                return this->args | views::drop(this->rest_loc);
+            }
         };
     protected:
         /// \param node_loc: index of the last node (in `Info.tree`)
         /// reached during `parse` before error
+        /// \param alloc: allocator of the vector returned
         /// \return: vector of related usages
-        static constexpr refs_type search_refs(std::size_t node_loc) noexcept {
-            using enum parse_node_type;
-            std::array<std::size_t, Info.tree.size()> deque;
+        static constexpr refs_type search_refs(std::size_t node_loc, const allocator_type& alloc) noexcept {
+            std::array<std::size_t, Info.tree.size()> queue;
             std::array<bool, Info.tree.size()> visited{};
-            refs_type refs;
-            refs.reserve(Info.usages.size());
-            auto front = deque.begin(), back = front + 1;
-            *front = node_loc;
-            auto push = [&back, &visited](std::size_t node_idx) {
-                if (!visited[node_idx]) {
-                    *(back++) = node_idx;
-                    visited[node_idx] = true;
-                }
-            };
-            while (front != back) {
-                const auto& node = Info.tree[*front];
-                switch (node.type) {
-                    case option:
-                    case variable_option: {
-                        push(node.next);
-                        std::size_t next_option = node.next_placeholder;
-                        if (next_option) {
-                            *front = next_option;
-                            continue;
-                        }
-                        break;
+            std::array<std::size_t, Info.usages.size()> usage_indices;
+            const std::size_t count =
+                detail::related_usages<char_type>(Info.tree, node_loc, queue, visited, usage_indices);
+            refs_type refs(typename refs_type::allocator_type{alloc});
+            refs.reserve(count);
+            for (std::size_t i = 0; i < count; ++i) refs.push_back(Info.usages.data() + usage_indices[i]);
+            return refs;
+        }
+        /// Calls `f` (which parses a command), and records its outcome and latency in `metrics_type`.
+        /// When metrics are disabled, this is simply `f()`.
+        template <typename F>
+        constexpr auto measured(F&& f) {
+            if constexpr (std::same_as<metrics_type, no_metrics>) {
+                return std::forward<F>(f)();
+            } else {
+                if consteval {
+                    return std::forward<F>(f)();
+                } else {
+                    const auto start = std::chrono::steady_clock::now();
+                    auto res = std::forward<F>(f)();
+                    const std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - start;
+                    if (res) {
+                        metrics_type::record(res->usage_index, latency);
+                    } else {
+                        metrics_type::record(res.error().type, latency);
                     }
-                    case variable:
-                        push(node.next);
-                        break;
-                    case end:
-                        refs.push_back(Info.usages.data() + node.usage_index);
-                        break;
+                    return res;
                 }
-                ++front;
             }
-            return refs;
         }
-    public:
-        /// \param args: an `input_range` of arguments that form a command
-        /// \return If `Args` is a forward range,
-        /// return an `std::expected<parse_result, parse_error>`;
-        /// otherwise, return an `std::expected<part_parse_result, part_parse_error>`.
+        /// Matches `args` against `Info.tree`. All `parse` overloads end up here.
         template <typename Args>
         requires RANGE_OF(Args, input_range, string_view_type)
-        constexpr auto parse(Args&& args) noexcept {
-            using enum parse_node_type;
-            using enum error_type;
-            using args_type = std::remove_cvref_t<Args>;
-            using iter_type = ranges::iterator_t<args_type>;
-            using sentinel_type = ranges::sentinel_t<args_type>;
+        constexpr auto match(Args&& args) noexcept {
             constexpr bool full_result = ranges::forward_range<Args>;
             using return_type = std::conditional_t<full_result,
                 std::expected<parse_result<Args>, parse_error<Args>>,
                 std::expected<part_parse_result, part_parse_error>>;
-            auto node = Info.tree.begin();
-            auto start_node = node;
-            auto arg_current = ranges::begin(args);
-            auto arg_end = ranges::end(args);
-            std::size_t arg_loc = 0;
-            auto next_arg = [&arg_current, &arg_loc]() {
-                ++arg_current; ++arg_loc;
-            };
-            auto next_arg_node = [&start_node, &node, next_arg](std::size_t next_node_idx) {
-                start_node = node = Info.tree.begin() + next_node_idx;
-                next_arg();
-            };
-            auto raise = [&start_node, &args, &arg_loc](error_type err, std::size_t in_arg_loc = 0) {
-                refs_type refs = search_refs(start_node - Info.tree.begin());
+            auto raise = [this, &args](error_type err, std::size_t start_node, error_loc loc) {
+                refs_type refs = search_refs(start_node, allocator_);
                 if constexpr (full_result) {
-                    return return_type{std::unexpect,
-                        err, std::forward<Args>(args), error_loc{arg_loc, in_arg_loc}, refs};
+                    return return_type{std::unexpect, err, std::forward<Args>(args), loc, std::move(refs)};
                 } else {
-                    return return_type{std::unexpect, err, refs};
+                    return return_type{std::unexpect, err, std::move(refs)};
                 }
             };
-            string_view_type arg;
-            while (true) {
-                if (arg_current == arg_end) [[unlikely]] {
-                    while (node->next_placeholder) {
-                        node = Info.tree.begin() + node->next_placeholder;
-                    }
-                    if (node->type != variadic && node->type != end) {
-                        return raise(too_few_arguments);
-                    }
+            auto succeed = [&args](std::size_t usage_index, std::size_t rest_loc) {
+                if constexpr (full_result) {
+                    return return_type{std::in_place,
+                        Info.usages[usage_index].name, usage_index, rest_loc, std::forward<Args>(args)};
                 } else {
-                    arg = *arg_current;
+                    return return_type{std::in_place, Info.usages[usage_index].name, usage_index, rest_loc};
                 }
-                parse_arg:
-                switch (node->type) {
-                    case option:
-                    case variable_option: {
-                        if (node->option_name == arg) {
-                            if (node->type == variable_option) {
-                                vars_[node->var_index] = {string_type{arg}, {arg_loc, 0}};
-                            }
-                            next_arg_node(node->next);
-                        } else if (node->next_placeholder) {
-                            node = Info.tree.begin() + node->next_placeholder;
-                            if !consteval {goto parse_arg;}
-                        } else [[unlikely]] {
-                            return raise(unknown_option);
-                        }
-                        continue;
-                    }
-                    case variable: {
-                        if (arg.starts_with(config.specials.flag_prefix)) {
-                            return raise(flag_cannot_be_variable);
-                        }
-                        vars_[node->var_index] = {string_type{arg}, {arg_loc, 0}};
-                        next_arg_node(node->next);
-                        continue;
-                    }
-                    case variadic: {
-                        if constexpr (std::sized_sentinel_for<iter_type, sentinel_type>) {
-                            variadic_.reserve(ranges::end(args) - arg_current);
-                        } else if constexpr (ranges::sized_range<args_type>) {
-                            variadic_.reserve(ranges::size(args));
-                        }
-                        for (; arg_current != arg_end; next_arg()) {
-                            arg = *arg_current;
-                            if (arg.starts_with(config.specials.flag_prefix)) break;
-                            variadic_.emplace_back(arg);
-                        }
-                        break;
-                    }
-                    case end: {
-                        break;
-                    }
-                }
-                break;
-            }
-            for (;arg_current != arg_end; ++arg_current) {
-                string_view_type flag_str = *arg_current;
-                if (flag_str.starts_with(config.specials.flag_prefix)) [[likely]] {
-                    const std::size_t eq_pos = flag_str.find(config.specials.equal);
-                    string_view_type flag_name = flag_str.substr(0, eq_pos);
-                    const std::size_t h = get_hash<hash_type, Info.flag_set.size()>(flag_name);
-                    const auto& flag = Info.flag_set[h];
-                    if (flag.name == flag_name && flag.defined_for[node->usage_index]) [[likely]] {
-                        flags_[h] = true;
-                        if (eq_pos != flag_str.npos) {
-                            if (std::size_t var_index = flag.var_index_for[node->usage_index]) [[likely]] {
-                                vars_[var_index] = {
-                                    string_type{flag_str.substr(eq_pos + config.specials.equal.size())},
-                                    {arg_loc, eq_pos + 1}
-                                };
-                            } else {
-                                return raise(flag_does_not_accept_argument, eq_pos);
-                            }
-                        }
-                    } else {
-                        return raise(unknown_flag);
+            };
+            if constexpr (Policy::erased) {
+                if !consteval {
+                    auto current = ranges::begin(args);
+                    const auto last = ranges::end(args);
+                    detail::erased_args<string_view_type> erased_args{current, last};
+                    detail::erased_state<string_view_type> state{this,
+                        [](void* self, std::size_t var_index, string_view_type value, error_loc loc) {
+                            static_cast<parser*>(self)->capture(var_index, value, loc);
+                        },
+                        [](void* self, std::size_t var_index, std::size_t choice_index) noexcept {
+                            static_cast<parser*>(self)->choose(var_index, choice_index);
+                        },
+                        [](void* self, std::size_t slot) noexcept {static_cast<parser*>(self)->flags_[slot] = true;},
+                        [](void* self, string_view_type arg) {return static_cast<parser*>(self)->push_variadic(arg);},
+                        nullptr
+                    };
+                    if constexpr (!std::same_as<tracer_type, no_tracer>) {
+                        state.trace_ = [](void* self, trace_event event, std::size_t node, std::size_t arg) {
+                            static_cast<parser*>(self)->trace(event, node, arg);
+                        };
                     }
-                } else {
-                    return raise(too_many_arguments);
+                    const auto outcome = detail::erased_match(erased_tree, state, erased_args);
+                    if (outcome.error) return raise(*outcome.error, outcome.start_node, outcome.loc);
+                    return succeed(outcome.usage_index, outcome.rest_loc);
                 }
             }
-            if constexpr (full_result) {
-                return return_type{std::in_place,
-                    Info.usages[node->usage_index].name, node->usage_index, std::forward<Args>(args)};
+            return detail::matcher::match(tree_access{}, *this, args, raise, succeed);
+        }
+    public:
+        /// \param args: an `input_range` of arguments that form a command
+        /// \return If `Args` is a forward range,
+        /// return an `std::expected<parse_result, parse_error>`;
+        /// otherwise, return an `std::expected<part_parse_result, part_parse_error>`.
+        /// If `Policy::response_files_type` expands response files,
+        /// `args` of the result is the expanded arguments instead.
+        template <typename Args>
+        requires RANGE_OF(Args, input_range, string_view_type)
+        constexpr auto parse(Args&& args) noexcept {
+            using response_files_type = Policy::response_files_type;
+            if constexpr (std::same_as<response_files_type, no_response_files>) {
+                return measured([this, &args] {return match(std::forward<Args>(args));});
             } else {
-                return return_type{std::in_place, Info.usages[node->usage_index].name, node->usage_index};
+                static_assert(std::same_as<char_type, char>, "Response files are only expanded for char.");
+                return measured([this, &args] {
+                    auto expanded = response_files_type::expand(std::forward<Args>(args), config.specials);
+                    using return_type = decltype(match(std::move(expanded)));
+                    if (const auto err = expanded.error()) [[unlikely]] {
+                        const error_loc loc{expanded.error_index(), 0};
+                        return return_type{std::unexpect, *err, std::move(expanded), loc};
+                    }
+                    return match(std::move(expanded));
+                });
             }
         }
         /// \param argc: number of arguments
@@ -602,25 +1256,51 @@ namespace cmd {
         /// using `std::codecvt` with the system locale.
         constexpr auto parse(int argc, char* argv[])
         requires (!std::same_as<char_type, char>) {
-            std::vector<string_type> args;
+            args_type args(allocator_);
             args.reserve(argc - 1);
             const translator<char, char_type, true> t{};
             for (std::string_view arg : views::counted(argv + 1, argc - 1)) {
-                args.push_back(t(arg, t.default_size_mul, ""));
+                args.push_back(t(arg, t.default_size_mul, std::locale{""}, allocator_));
             }
             return parse(std::move(args));
         }
-        /// \param str: an `input_range` of `char_type` that forms a command string
-        /// \return `std::expected<parse_result, parse_error>`
-        /// \remark This method creates a vector of arguments that is parsed from `str`.
-        template <typename Str>
-        requires RANGE_OF(Str, input_range, char_type)
-        constexpr auto parse(const Str& str) {
-            using enum error_type;
-            std::vector<string_type> args;
-            args.assign({{}});
+        /// \param buffer: arguments, each followed by `separator` (optional after the last argument)
+        /// \return `std::expected<parse_result, parse_error>`, whose `args` is a `delimited_range` of `buffer`
+        /// \remark `buffer` must outlive the result, since arguments and locations are views into it.
+        constexpr auto parse(string_view_type buffer, char_type separator) noexcept {
+            return parse(delimited_range<char_type, char_traits_type>{buffer, separator});
+        }
+        /// Splits a command string into arguments.
+        /// All state is kept in the object, so a command can be fed in chunks.
+        struct tokenizer {
+            /// Completed arguments.
+            args_type args;
+            /// Argument being read.
+            string_type current;
             bool quote_open = false, escape = false;
-            for (const char_type& c : str) {
+            /// \internal Whether `current` counts as an argument when the command ends.
+            /// It is only `false` right after `push`.
+            bool trailing = true;
+            /// Whether a limit in `config.limits` has been crossed, after which arguments are no longer stored
+            /// (but quotes and escapes are still tracked, so that the end of the command can be found).
+            bool exceeded = false;
+            /// Number of characters fed.
+            std::size_t size = 0;
+
+            explicit constexpr tokenizer(const allocator_type& alloc = {}) : args(alloc), current(alloc) {}
+
+            /// Appends `current` to `args`, unless there are too many arguments.
+            constexpr void end_arg() {
+                if (args.size() >= config.limits.args) [[unlikely]] {
+                    exceeded = true;
+                    return;
+                }
+                args.push_back(std::move(current));
+                current.clear();
+            }
+            constexpr void feed(char_type c) {
+                if (++size > config.limits.command_size) [[unlikely]] exceeded = true;
+                trailing = true;
                 if (quote_open || !char_traits_type::eq(c, config.specials.delimiter)) {
                     if (escape) {
                         escape = false;
@@ -628,54 +1308,264 @@ namespace cmd {
                         if constexpr (char_traits_type::eq(config.specials.quote_open, config.specials.quote_close)) {
                             if (char_traits_type::eq(c, config.specials.quote_open)) {
                                 quote_open = !quote_open;
-                                continue;
+                                return;
                             }
                         } else {
                             if (char_traits_type::eq(c, config.specials.quote_open)) {
                                 quote_open = true;
-                                continue;
+                                return;
                             }
                             if (char_traits_type::eq(c, config.specials.quote_close)) {
                                 quote_open = false;
-                                continue;
+                                return;
                             }
                         }
                         if (char_traits_type::eq(c, config.specials.escape)) {
                             escape = true;
-                            continue;
+                            return;
                         }
                     }
-                    args.back().push_back(c);
+                    if (exceeded || current.size() >= config.limits.arg_size) [[unlikely]] {
+                        exceeded = true;
+                        return;
+                    }
+                    current.push_back(c);
                 } else {
-                    if (!args.back().empty()) args.push_back({});
+                    if (!exceeded && !current.empty()) end_arg();
+                }
+            }
+            /// \param str: an `input_range` of `char_type`, which is read until a limit is crossed
+            template <typename Str>
+            requires RANGE_OF(Str, input_range, char_type)
+            constexpr void feed(const Str& str) {
+                for (const char_type& c : str) {
+                    feed(c);
+                    if (exceeded) [[unlikely]] return;
+                }
+            }
+            /// Ends the argument being read (if any) and appends `arg` as a whole argument.
+            /// \remark `arg` is taken verbatim, i.e. special characters in it are not interpreted.
+            constexpr void push(string_view_type arg) {
+                if (!exceeded && !current.empty()) end_arg();
+                size += arg.size();
+                if (exceeded || args.size() >= config.limits.args || arg.size() > config.limits.arg_size ||
+                    size > config.limits.command_size) [[unlikely]] {
+                    exceeded = true;
+                    return;
+                }
+                args.emplace_back(arg);
+                trailing = false;
+            }
+            /// \return whether a quote or an escape is still open
+            constexpr bool open() const noexcept {
+                return quote_open || escape;
+            }
+            /// \return all arguments read, leaving the tokenizer in a valid but unspecified state
+            constexpr args_type release() {
+                if (!exceeded && (!args.empty() || !current.empty())) {
+                    if (trailing) end_arg();
                 }
+                return std::move(args);
             }
-            if (args.front().empty()) args.clear();
+            /// Same as `release`, except that delimiters at the end do not start an empty argument.
+            /// Used to split scripts, where `a ; b` is common.
+            constexpr args_type release_trimmed() {
+                if (current.empty()) trailing = false;
+                return release();
+            }
+        };
+    protected:
+        /// Parses the arguments read by `tok`.
+        constexpr auto parse_tokens(tokenizer&& tok) {
+            using enum error_type;
+            const bool open = tok.open();
+            args_type args = tok.release();
 
-            auto get_return = [this, &args]() {return parse(std::move(args));};
+            auto get_return = [this, &args]() {return match(std::move(args));};
             using return_type = std::invoke_result_t<decltype(get_return)>;
-            if (quote_open || escape) [[unlikely]] {
+            if (tok.exceeded) [[unlikely]] {
+                // points past the arguments read before the limit
+                const error_loc loc{args.size(), 0};
+                return return_type{std::unexpect, limit_exceeded, std::move(args), loc};
+            }
+            if (open) [[unlikely]] {
                 return return_type{std::unexpect, open_special_character, std::move(args)};
             }
             return get_return();
         }
+    public:
+        /// A parse whose input arrives incrementally.
+        /// Characters and arguments fed to a session are split into arguments right away,
+        /// so the work done per chunk is proportional to the size of the chunk.
+        /// The arguments are matched against `Info.tree` when `finish` is called.
+        /// \remark A session writes to the variables and flags of the `parser` it is bound to.
+        class parse_session {
+            parser& parser_;
+            tokenizer tokenizer_;
+        public:
+            explicit constexpr parse_session(parser& p) : parser_{p}, tokenizer_{p.allocator_} {}
+            /// Feeds a chunk of a command string.
+            /// \param str: an `input_range` of `char_type`
+            template <typename Str>
+            requires RANGE_OF(Str, input_range, char_type)
+            constexpr parse_session& feed(const Str& str) {
+                tokenizer_.feed(str);
+                return *this;
+            }
+            constexpr parse_session& feed(char_type c) {
+                tokenizer_.feed(c);
+                return *this;
+            }
+            /// Feeds a whole argument. Special characters in `arg` are not interpreted.
+            constexpr parse_session& push(string_view_type arg) {
+                tokenizer_.push(arg);
+                return *this;
+            }
+            /// \return whether a quote or an escape is still open
+            constexpr bool open() const noexcept {
+                return tokenizer_.open();
+            }
+            /// Parses everything fed so far, and starts a new command.
+            /// \return `std::expected<parse_result, parse_error>`, same as `parse(const Str&)`
+            constexpr auto finish() {
+                return parser_.measured([this] {
+                    return parser_.parse_tokens(std::exchange(tokenizer_, tokenizer{parser_.allocator_}));
+                });
+            }
+        };
+        /// \param str: an `input_range` of `char_type` that forms a command string
+        /// \return `std::expected<parse_result, parse_error>`
+        /// \remark This method creates a vector of arguments that is parsed from `str`.
+        template <typename Str>
+        requires RANGE_OF(Str, input_range, char_type)
+        constexpr auto parse(const Str& str) {
+            return measured([this, &str] {
+                tokenizer tok{allocator_};
+                tok.feed(str);
+                return parse_tokens(std::move(tok));
+            });
+        }
+        /// A command parsed at compile time by `precompiled`.
+        /// It never allocates: variables and variadic arguments are views into its own static storage.
+        /// \tparam CharsSize: total size of variables and variadic arguments
+        /// \tparam VariadicSize: number of variadic arguments
+        template <std::size_t CharsSize, std::size_t VariadicSize>
+        class precompiled_result {
+            friend parser;
+            using range_type = std::pair<std::size_t, std::size_t>;
+            std::array<char_type, CharsSize> chars_{};
+            /// \internal Offset and size in `chars_` of each variable and variadic argument.
+            std::array<range_type, Info.var_names.size()> vars_{};
+            std::array<range_type, VariadicSize> variadic_{};
+            std::bitset<Info.flag_set.size()> flags_{};
+
+            constexpr string_view_type view(range_type range) const noexcept {
+                return {chars_.data() + range.first, range.second};
+            }
+        public:
+            result_type result{};
+            std::size_t usage_index = 0;
+
+            /// \return value of variable named `name`
+            constexpr string_view_type var(var_name name) const noexcept {
+                return view(vars_[name.index]);
+            }
+            /// \return whether flag named `name` is set
+            constexpr bool flag(flag_name name) const noexcept {
+                return flags_[name.index];
+            }
+            /// \return range of variadic arguments
+            constexpr auto variadic() const noexcept {
+                return variadic_ | views::transform([this](range_type range) {return view(range);});
+            }
+        };
+    private:
+        /// \internal Parser for `precompiled`, which parses in constant evaluation.
+        using constant_parser = cmd::parser<Info, detail::constant_policy<Policy>>;
+        /// \internal Sizes of the `precompiled_result` of `Command`, or the diagnostic if it cannot be parsed.
+        /// \remark `make_precompiled` parses `Command` again: the sizes are template arguments of its result,
+        /// and nothing allocated in one constant evaluation (like `save()`) can be passed on to another.
+        template <fixed_string Command>
+        static consteval std::expected<std::pair<std::size_t, std::size_t>, detail::precompile_error>
+        precompiled_sizes() {
+            constant_parser p;
+            const auto res = p.parse(string_view_type{Command.value, Command.size()});
+            if (!res) {
+                std::string_view what, arg;
+                const std::size_t arg_loc = res.error().ref.loc.arg_loc;
+                if constexpr (std::same_as<format_char_type, char>) {
+                    what = config.error_msgs[std::to_underlying(res.error().type)];
+                }
+                if constexpr (std::same_as<char_type, char>) {
+                    if (arg_loc < ranges::size(res.error().ref.args)) arg = res.error().ref.args[arg_loc];
+                }
+                return std::unexpected(detail::precompile_error{what, arg_loc, arg});
+            }
+            const auto saved = p.save();
+            std::size_t chars_size = 0;
+            for (const auto& var : saved.vars) chars_size += var.content.size();
+            for (const auto& arg : saved.variadic) chars_size += arg.size();
+            return std::pair{chars_size, saved.variadic.size()};
+        }
+        template <fixed_string Command, std::size_t CharsSize, std::size_t VariadicSize>
+        static consteval precompiled_result<CharsSize, VariadicSize> make_precompiled() {
+            constant_parser p;
+            const auto res = p.parse(string_view_type{Command.value, Command.size()});
+            const auto saved = p.save();
+            precompiled_result<CharsSize, VariadicSize> out;
+            std::size_t offset = 0;
+            auto store = [&out, &offset](const auto& str) {
+                ranges::copy(str, out.chars_.begin() + offset);
+                offset += str.size();
+                return std::pair{offset - str.size(), str.size()};
+            };
+            for (std::size_t i = 0; i < saved.vars.size(); ++i) out.vars_[i] = store(saved.vars[i].content);
+            for (std::size_t i = 0; i < VariadicSize; ++i) out.variadic_[i] = store(saved.variadic[i]);
+            out.flags_ = saved.flags;
+            out.result = res->result;
+            out.usage_index = res->usage_index;
+            return out;
+        }
+        template <fixed_string Command, std::size_t CharsSize, std::size_t VariadicSize>
+        static constexpr auto precompiled_storage = make_precompiled<Command, CharsSize, VariadicSize>();
+    public:
+        /// Parses `Command` at compile time, e.g. `parser.precompiled<"save x --value=3">()`.
+        /// The build fails with the error message if `Command` cannot be parsed.
+        /// \tparam Command: a command string, split into arguments like `parse(const Str&)`
+        /// \return reference to a static `precompiled_result`, so nothing is done at runtime
+        template <fixed_string Command>
+        requires std::same_as<typename decltype(Command)::char_type, char_type>
+        static consteval const auto& precompiled() noexcept {
+            constexpr auto sizes = precompiled_sizes<Command>();
+            if constexpr (sizes) {
+                return precompiled_storage<Command, sizes->first, sizes->second>;
+            } else {
+#if __cpp_static_assert >= 202306L
+                static_assert(false, sizes.error());
+#else
+                static_assert(sizes.has_value(), "invalid precompiled command");
+#endif
+            }
+        }
         /// Reads and parses a line from standard input.
         /// \return `std::expected<parse_result, parse_error>`
         auto readline()
         requires inputtable {
             using iter_type = std::istreambuf_iterator<char_type>;
             *input_stream >> std::ws;
-            return parse(
-                ranges::subrange(iter_type(*input_stream), iter_type())
-                | views::take_while([](char_type c) {
-                    const char_type eol = input_stream->widen('\n');
-                    if (char_traits_type::eq(c, eol)) {
-                        input_stream->ignore(std::numeric_limits<std::streamsize>::max(), eol);
-                        return false;
-                    } else {
-                        return true;
-                    }
-                }));
+            // the line is read before `parse`, so that time blocked on the stream is not measured as parsing.
+            // Past one character over `command_size`, which the tokenizer rejects, the rest is skipped.
+            const char_type eol = input_stream->widen('\n');
+            string_type line(allocator_);
+            for (iter_type it(*input_stream), end; it != end; ++it) {
+                const char_type c = *it;
+                if (char_traits_type::eq(c, eol)) {
+                    input_stream->ignore();
+                    break;
+                }
+                if (line.size() <= config.limits.command_size) line.push_back(c);
+            }
+            return parse(line);
         }
         auto readline()
         requires (!inputtable) {
@@ -714,28 +1604,449 @@ namespace cmd {
         constexpr bool flag(flag_name name) const noexcept {
             return flags_[name.index];
         }
+        /// \return index of the option that variable named `name` matched among those declared with it
+        /// (e.g. 2 for `mul` in `<op>=(add|minus|mul|div)`), or -1 if it did not match one,
+        /// so that the command can be dispatched without comparing strings
+        /// \remark Variables declared with a capture (e.g. `<op>=(add|...)`) accept any value,
+        /// so their choice is always -1.
+        /// \tparam T: type of the index, e.g. an enumeration that lists the options in the same order
+        template <typename T = std::size_t>
+        constexpr T choice(var_name name) const noexcept {
+            return static_cast<T>(vars_[name.index].choice);
+        }
         /// \return vector of variadic variables captured during `parse`
-        constexpr const std::vector<string_type>& variadic() const noexcept {
+        constexpr const variadic_type& variadic() const noexcept {
             return variadic_;
         }
+        /// Same as `parse(input)`, except that variadic arguments are converted to numbers
+        /// (e.g. `std::int64_t` or `double`) as they are matched, straight from the arguments into `variadic`,
+        /// instead of being copied to `variadic()`.
+        /// Plain decimal integers are validated and converted 8 characters at a time,
+        /// and anything else goes through `std::from_chars`.
+        /// \param input: anything `parse` takes as a single argument
+        /// \param variadic: cleared, then filled with the numbers; its memory is kept across calls
+        /// \param what: error message if an argument is not a valid `T`
+        /// \return same as `parse(input)`; a variadic argument that is not a valid `T` fails with a
+        /// `parse_error` of `error_type::invalid_argument` at its first invalid character, whose `what` is `what`
+        /// \remark `variadic()` is left empty.
+        template <typename T, typename Alloc, typename Input>
+        requires ((std::integral<T> && !std::same_as<T, bool>) || std::floating_point<T>) && std::integral<char_type>
+            && requires (parser& p, Input&& input) {p.parse(std::forward<Input>(input));}
+        auto parse(Input&& input, std::vector<T, Alloc>& variadic, format_string_view_type what) {
+            variadic.clear();
+            variadic_sink_ = {&variadic,
+                [](void* out, std::size_t size) {static_cast<std::vector<T, Alloc>*>(out)->reserve(size);},
+                [](void* out, string_view_type arg) -> std::optional<std::size_t> {
+                    T value;
+                    if (auto pos = detail::parse_number(arg, value)) [[unlikely]] return pos;
+                    static_cast<std::vector<T, Alloc>*>(out)->push_back(value);
+                    return std::nullopt;
+                }
+            };
+            auto res = parse(std::forward<Input>(input));
+            variadic_sink_ = {};
+            if constexpr (requires {res.error().what;}) {
+                if (!res && res.error().type == error_type::invalid_argument) res.error().what = what;
+            }
+            return res;
+        }
+    private:
+        /// \internal A parameter passed by `dispatch` to a handler.
+        struct dispatch_param {
+            enum kind_type {
+                var, flag, flag_var, variadic
+            } kind = var;
+            /// Index in `vars_` (`var` and `flag_var`) and in `flags_` (`flag` and `flag_var`).
+            std::size_t var_index = 0, flag_index = 0;
+        };
+        /// \internal Finds the parameters of the handler of usage no. `usage_index`, in the order they are declared.
+        /// \param out: receives the parameters, unless it is null
+        /// \return number of parameters
+        /// \throw std::logic_error (which fails compilation, since this only runs in constant evaluation)
+        /// if a variable or flag of the usage is not found in `Info`, instead of dropping the parameter
+        static constexpr std::size_t scan_dispatch_params(std::size_t usage_index, dispatch_param* out) {
+            constexpr const auto& specials = config.specials;
+            auto var_index = [](string_view_type t) {
+                t.remove_prefix(specials.var_open.size());
+                t = t.substr(0, t.find(specials.var_close));
+                const auto it = ranges::find(Info.var_names, t);
+                if (it == Info.var_names.end()) [[unlikely]] {
+                    throw std::logic_error("A handler parameter names no variable.");
+                }
+                return static_cast<std::size_t>(it - Info.var_names.begin());
+            };
+            std::size_t count = 0;
+            auto push = [out, &count](dispatch_param param) {
+                if (out) out[count] = param;
+                ++count;
+            };
+            for (const auto& token : Info.usages[usage_index].format | views::split(specials.delimiter)) {
+                string_view_type t{token};
+                if (t.starts_with(specials.flag_open) && t.ends_with(specials.flag_close)) {
+                    t.remove_prefix(specials.flag_open.size());
+                    t.remove_suffix(specials.flag_close.size());
+                    const std::size_t eq_pos = t.find(specials.equal);
+                    const string_view_type flag_name = t.substr(0, eq_pos);
+                    const std::size_t h = get_hash<hash_type, Info.flag_set.size()>(flag_name);
+                    if (Info.flag_set[h].name != flag_name) [[unlikely]] {
+                        throw std::logic_error("A handler parameter names no flag.");
+                    }
+                    if (eq_pos == t.npos) {
+                        push({.kind = dispatch_param::flag, .flag_index = h});
+                    } else {
+                        push({
+                            .kind = dispatch_param::flag_var,
+                            .var_index = var_index(t.substr(eq_pos + specials.equal.size())),
+                            .flag_index = h
+                        });
+                    }
+                } else if (t.starts_with(specials.var_open)) {
+                    push({.kind = dispatch_param::var, .var_index = var_index(t)});
+                } else if (t == specials.variadic) {
+                    push({.kind = dispatch_param::variadic});
+                }
+            }
+            return count;
+        }
+        template <std::size_t UsageIndex>
+        static constexpr auto dispatch_params = [] {
+            std::array<dispatch_param, scan_dispatch_params(UsageIndex, nullptr)> params{};
+            scan_dispatch_params(UsageIndex, params.data());
+            return params;
+        }();
+        /// \internal \return the argument for `Param`, read straight from the parse state
+        template <dispatch_param Param>
+        constexpr decltype(auto) dispatch_arg() const noexcept {
+            if constexpr (Param.kind == dispatch_param::var) {
+                return string_view_type{vars_[Param.var_index].content};
+            } else if constexpr (Param.kind == dispatch_param::flag) {
+                return bool{flags_[Param.flag_index]};
+            } else if constexpr (Param.kind == dispatch_param::flag_var) {
+                return flags_[Param.flag_index]
+                    ? std::optional<string_view_type>{vars_[Param.var_index].content}
+                    : std::nullopt;
+            } else {
+                return (variadic_);
+            }
+        }
+        template <std::size_t UsageIndex, typename Handler>
+        constexpr decltype(auto) invoke_handler(Handler& handler) const {
+            return [this, &handler]<std::size_t... I>(std::index_sequence<I...>) -> decltype(auto) {
+                return std::invoke(handler, dispatch_arg<dispatch_params<UsageIndex>[I]>()...);
+            }(std::make_index_sequence<dispatch_params<UsageIndex>.size()>{});
+        }
+        template <typename Handlers, std::size_t... I>
+        static auto dispatch_result(std::index_sequence<I...>) -> std::common_type_t<decltype(
+            std::declval<const parser&>().template invoke_handler<I>(std::declval<std::tuple_element_t<I, Handlers>>())
+        )...>;
+        template <typename Result, typename Handlers, std::size_t UsageIndex>
+        static constexpr Result dispatch_thunk(const parser& self, Handlers& handlers) {
+            return static_cast<Result>(self.invoke_handler<UsageIndex>(std::get<UsageIndex>(handlers)));
+        }
+        /// \internal One entry per usage, so that `dispatch` is a single indirect call.
+        template <typename Result, typename Handlers>
+        static constexpr auto dispatch_table = []<std::size_t... I>(std::index_sequence<I...>) {
+            return std::array<Result (*)(const parser&, Handlers&), sizeof...(I)>{
+                &dispatch_thunk<Result, Handlers, I>...
+            };
+        }(std::make_index_sequence<Info.usages.size()>{});
+    public:
+        /// Calls the handler of the usage that `res` matched, with the variables and flags of the usage
+        /// as arguments in the order they are declared, e.g. `(std::string_view path, bool force)`
+        /// for `add <path> [--force]`:
+        /// - `<var>` (including variable options) is passed as `string_view_type`;
+        /// - `[--flag]` is passed as `bool`;
+        /// - `[--flag=<var>]` is passed as `std::optional<string_view_type>`, which is empty if the flag is not set;
+        /// - `...` is passed as `const variadic_type&`.
+        /// \param res: a successful result of `parse`
+        /// \param handlers: one for each usage, in the order of `config.usages`
+        /// \return the result of the handler, converted to the common type of the results of all handlers
+        /// \remark The handler is found in a table built at compile time, and its arguments are views of
+        /// the variables of the parser, so nothing is looked up by name or copied.
+        template <typename... Handlers>
+        requires (sizeof...(Handlers) == Info.usages.size())
+        constexpr auto dispatch(const part_parse_result& res, Handlers&&... handlers) const {
+            using handlers_type = std::tuple<Handlers&...>;
+            using dispatch_result_type =
+                decltype(dispatch_result<handlers_type>(std::make_index_sequence<sizeof...(Handlers)>{}));
+            handlers_type refs{handlers...};
+            return dispatch_table<dispatch_result_type, handlers_type>[res.usage_index](*this, refs);
+        }
+        /// Looks up a variable whose name is only known at runtime, e.g. `parser.var(*parser.find_var(name))`.
+        /// \return the variable named `name`, or `std::nullopt` if there is none
+        /// \remark `name` is looked up in `Info.var_table`, a perfect hash set, so this is a single probe.
+        static constexpr std::optional<var_name> find_var(string_view_type name) noexcept {
+            const std::size_t index =
+                Info.var_table[get_var_slot<hash_type>(name, def.var_hash_multiplier, Info.var_table.size())];
+            if (index == 0 || Info.var_names[index] != name) return std::nullopt;
+            return var_name{index};
+        }
+        /// Same as `find_var`, for flags, whose names include their prefix.
+        static constexpr std::optional<flag_name> find_flag(string_view_type name) noexcept {
+            const std::size_t h = get_hash<hash_type, Info.flag_set.size()>(name);
+            if (!Info.flag_set[h].defined() || Info.flag_set[h].name != name) return std::nullopt;
+            return flag_name{h};
+        }
+        /// \return range of the names and values of the variables captured during `parse`
+        constexpr auto captured_vars() const noexcept {
+            return views::iota(1uz, Info.var_names.size())
+                | views::filter([this](std::size_t i) {return vars_[i].loc.arg_loc != -1uz;})
+                | views::transform([this](std::size_t i) {
+                    return std::pair{Info.var_names[i], string_view_type{vars_[i].content}};
+                });
+        }
+        /// \return range of the names of the flags set during `parse`, in no particular order
+        constexpr auto set_flags() const noexcept {
+            return views::iota(0uz, Info.flag_set.size())
+                | views::filter([this](std::size_t h) {return flags_[h];})
+                | views::transform([](std::size_t h) {return Info.flag_set[h].name;});
+        }
+        /// Everything captured during `parse`: variables, flags and variadic arguments.
+        struct snapshot {
+            vars_type vars;
+            std::bitset<Info.flag_set.size()> flags;
+            variadic_type variadic;
+        };
+        /// \return a copy of everything captured since the last `reset`
+        constexpr snapshot save() const {
+            return {vars_, flags_, variadic_};
+        }
+        /// Replaces everything captured with `saved`, reusing memory held by variables.
+        constexpr void restore(const snapshot& saved) {
+            for (auto [var, saved_var] : views::zip(vars_, saved.vars)) {
+                var.content.assign(saved_var.content);
+                var.loc = saved_var.loc;
+                var.choice = saved_var.choice;
+            }
+            flags_ = saved.flags;
+            variadic_.assign(saved.variadic.begin(), saved.variadic.end());
+        }
         /// Clears values of all variables and sets all flags to `false`.
+        /// \remark Memory held by variables is kept for the next `parse`.
         constexpr void reset() noexcept {
-            vars_.fill({});
+            for (vars_element& var : vars_) {
+                var.content.clear();
+                var.loc = {};
+                var.choice = -1;
+            }
             flags_.reset();
             variadic_.clear();
         }
+    private:
+        /// \internal Start of a block written by `pack`.
+        struct packed_header {
+            result_type result;
+            std::size_t usage_index, rest_loc, variadic_size, size;
+        };
+        /// \internal Offset (in characters) and size of a variable or variadic argument in a block.
+        struct packed_range {
+            std::size_t offset, size;
+        };
+        static constexpr std::size_t packed_flag_words = (Info.flag_set.size() + 63) / 64;
+        static constexpr std::size_t packed_ranges_offset = sizeof(packed_header) + packed_flag_words * 8;
+        static constexpr std::size_t packed_chars_offset(std::size_t variadic_size) noexcept {
+            return packed_ranges_offset + (Info.var_names.size() + variadic_size) * sizeof(packed_range);
+        }
+    public:
+        /// A view of a result packed by `pack`, with the same accessors as the parser.
+        /// The block starts with the result, followed by the flags, the offset and size
+        /// of each variable and variadic argument, and their characters.
+        /// It holds no pointers, so it can be copied with `memcpy` (e.g. through a queue or shared memory)
+        /// and viewed wherever it lands.
+        class packed_result {
+            const std::byte* data_;
+
+            // the block may be a copy made with `memcpy`, so the header and ranges are loaded the same way
+            packed_header header() const noexcept {
+                packed_header header;
+                std::memcpy(&header, data_, sizeof header);
+                return header;
+            }
+            /// \param i: index of a variable, or `Info.var_names.size()` + index of a variadic argument
+            packed_range range(std::size_t i) const noexcept {
+                packed_range range;
+                std::memcpy(&range, data_ + packed_ranges_offset + i * sizeof range, sizeof range);
+                return range;
+            }
+            const char_type* chars() const noexcept {
+                const packed_header header = this->header();
+                const std::size_t offset = packed_chars_offset(header.variadic_size);
+                // the characters were written by `memcpy` (in `pack`, or when the block was copied),
+                // which implicitly creates them
+#if __cpp_lib_start_lifetime_as >= 202207L
+                return std::start_lifetime_as_array<char_type>(
+                    data_ + offset, (header.size - offset) / sizeof(char_type));
+#else
+                return std::launder(reinterpret_cast<const char_type*>(data_ + offset));
+#endif
+            }
+        public:
+            /// Alignment required of a block.
+            static constexpr std::size_t alignment = alignof(packed_header);
+
+            /// \param data: a block written by `pack`, or a copy of it, aligned to `alignment`
+            explicit packed_result(const std::byte* data) noexcept : data_{data} {}
+            result_type result() const noexcept {
+                return header().result;
+            }
+            std::size_t usage_index() const noexcept {
+                return header().usage_index;
+            }
+            /// Same as `part_parse_result::rest_loc`.
+            std::size_t rest_loc() const noexcept {
+                return header().rest_loc;
+            }
+            /// \return the block, whose size is that of `packed_size()` when it was packed
+            std::span<const std::byte> bytes() const noexcept {
+                return {data_, header().size};
+            }
+            /// \return value of variable named `name`
+            string_view_type var(var_name name) const noexcept {
+                const packed_range range = this->range(name.index);
+                return {chars() + range.offset, range.size};
+            }
+            /// \return whether flag named `name` is set
+            bool flag(flag_name name) const noexcept {
+                std::uint64_t word;
+                std::memcpy(&word, data_ + sizeof(packed_header) + name.index / 64 * 8, sizeof word);
+                return word >> name.index % 64 & 1;
+            }
+            /// \return range of variadic arguments
+            auto variadic() const noexcept {
+                return views::iota(Info.var_names.size(), Info.var_names.size() + header().variadic_size)
+                    | views::transform([result = *this, chars = chars()](std::size_t i) {
+                        const packed_range range = result.range(i);
+                        return string_view_type{chars + range.offset, range.size};
+                    });
+            }
+        };
+        /// A `packed_result` that owns its block, which is a single allocation.
+        class packed_block {
+            friend parser;
+            struct alignas(packed_result::alignment) unit {
+                std::byte bytes[packed_result::alignment];
+            };
+            std::vector<unit, allocator_for<unit>> units_;
+
+            packed_block(std::size_t size, const allocator_type& alloc) :
+                units_((size + sizeof(unit) - 1) / sizeof(unit), allocator_for<unit>{alloc}) {}
+            std::span<std::byte> storage() noexcept {
+                return std::as_writable_bytes(std::span{units_});
+            }
+        public:
+            packed_result get() const noexcept {
+                return packed_result{units_.front().bytes};
+            }
+            std::span<const std::byte> bytes() const noexcept {
+                return get().bytes();
+            }
+        };
+        /// \return size in bytes of the block `pack` writes for what was captured since the last `reset`
+        std::size_t packed_size() const noexcept {
+            std::size_t chars = 0;
+            for (const vars_element& var : vars_) chars += var.content.size();
+            for (const string_type& arg : variadic_) chars += arg.size();
+            return packed_chars_offset(variadic_.size()) + chars * sizeof(char_type);
+        }
+        /// Packs `res` and what was captured for it into `buffer`.
+        /// \param res: result of the last `parse`
+        /// \param buffer: memory aligned to `packed_result::alignment`
+        /// \return view of the block at the start of `buffer`,
+        /// or `std::nullopt` if `buffer` is misaligned or smaller than `packed_size()`
+        std::optional<packed_result> pack(const part_parse_result& res, std::span<std::byte> buffer) const noexcept {
+            const std::size_t size = packed_size();
+            if (buffer.size() < size ||
+                reinterpret_cast<std::uintptr_t>(buffer.data()) % packed_result::alignment != 0) [[unlikely]] {
+                return std::nullopt;
+            }
+            std::byte* const data = buffer.data();
+            const packed_header header{res.result, res.usage_index, res.rest_loc, variadic_.size(), size};
+            std::memcpy(data, &header, sizeof header);
+            std::array<std::uint64_t, packed_flag_words> words{};
+            for (std::size_t i = 0; i < flags_.size(); ++i) {
+                if (flags_[i]) words[i / 64] |= std::uint64_t{1} << i % 64;
+            }
+            std::memcpy(data + sizeof header, words.data(), sizeof words);
+            std::byte* range_out = data + packed_ranges_offset;
+            std::byte* const chars = data + packed_chars_offset(variadic_.size());
+            std::size_t offset = 0;
+            auto store = [&range_out, chars, &offset](string_view_type str) {
+                const packed_range range{offset, str.size()};
+                std::memcpy(range_out, &range, sizeof range);
+                range_out += sizeof range;
+                std::memcpy(chars + offset * sizeof(char_type), str.data(), str.size() * sizeof(char_type));
+                offset += str.size();
+            };
+            for (const vars_element& var : vars_) store(var.content);
+            for (const string_type& arg : variadic_) store(arg);
+            return packed_result{data};
+        }
+        /// Same as `pack(res, buffer)`, except that the block is allocated by the allocator of the parser.
+        packed_block pack(const part_parse_result& res) const {
+            packed_block block{packed_size(), allocator_};
+            pack(res, block.storage());
+            return block;
+        }
+    };
+
+    /// Parsers whose memory comes from a `std::pmr::memory_resource`.
+    namespace pmr {
+        struct policy : default_policy {
+            template <typename T>
+            using allocator_type = std::pmr::polymorphic_allocator<T>;
+        };
+        /// Construct with a `std::pmr::memory_resource*` to allocate from it.
+        /// The resource must outlive the parser and all results and errors it returns.
+        template <tagged<parser_info_tag> auto& Info>
+        using parser = cmd::parser<Info, policy>;
+    }
+
+    /// Information of a flag, for a number of usages only known at runtime.
+    template <char_like CharT>
+    struct dynamic_flag_info {
+        std::basic_string_view<CharT> name;
+        std::vector<bool> defined_for;
+        /// Index of the capturing variable for the flag in each usage.
+        /// A value of 0 means it does not exist.
+        std::vector<std::size_t> var_index_for;
+        constexpr bool defined() const noexcept {
+            return ranges::find(defined_for, true) != defined_for.end();
+        }
+    };
+    /// Parse tree, variable names and flag set built from usages by `detail::compile_usages`.
+    template <char_like CharT>
+    struct compiled_usages {
+        std::vector<parse_node<CharT>> tree;
+        std::vector<std::basic_string_view<CharT>> var_names;
+        std::vector<dynamic_flag_info<CharT>> flag_set;
+        /// Same as `parser_info::var_table`, with multiplier `var_hash_multiplier`.
+        /// Empty unless `compile_usages` is asked for it.
+        std::vector<std::size_t> var_table;
+        std::uint64_t var_hash_multiplier;
     };
 
     namespace detail {
-        template <const auto& Config, typename CharT, typename Hash, std::size_t FlagSetSize>
-        constexpr auto parse_usage(auto out) noexcept ->
-        std::expected<parser_def<std::remove_cvref_t<decltype(Config)>>, define_error> {
+        /// Number of times the variable table of `compile_usages` may double past the number of variables.
+        inline constexpr std::size_t var_table_max_growth = 8;
+        /// Builds the parse tree, variable names and flag set of the usages in `config`.
+        /// Unlike `define_parser`, this can be called at runtime.
+        /// \param config: `config::type`, or any object with `usages`, `specials` and `super_type`
+        /// \param flag_set_size: size of hash set for flags
+        /// \param with_var_table: whether to build `compiled_usages::var_table`, which requires
+        /// variable names to hash to distinct slots. Only `parser` looks variables up in it.
+        template <typename CharT, typename Hash>
+        constexpr auto compile_usages(const auto& config, std::size_t flag_set_size, bool with_var_table = false) ->
+        std::expected<compiled_usages<CharT>, define_error> {
             using string_view_type = std::basic_string_view<CharT>;
             using enum parse_node_type;
             using enum define_error_ref_type;
+            const std::size_t usage_size = ranges::size(config.usages);
             std::vector<parse_node<CharT>> tree;
             std::vector<string_view_type> var_names{{}};
-            std::array<flag_info<ranges::size(Config.usages), CharT>, FlagSetSize> flag_set;
+            std::vector<dynamic_flag_info<CharT>> flag_set(flag_set_size, dynamic_flag_info<CharT>{
+                .defined_for = std::vector<bool>(usage_size),
+                .var_index_for = std::vector<std::size_t>(usage_size)
+            });
             auto add_var = [&var_names] (string_view_type name) -> std::size_t {
                 auto search = ranges::find(var_names, name);
                 if (search == var_names.end()) {
@@ -745,44 +2056,44 @@ namespace cmd {
                     return search - var_names.begin();
                 }
             };
-            for (auto [i, usage] : Config.usages | views::enumerate) {
+            for (auto [i, usage] : config.usages | views::enumerate) {
                 bool searching = !tree.empty();
                 bool ended = false;
                 parse_node_type end_type = end;
                 // current node in traversal, final value is first unmatched node
                 std::size_t current = 0;
                 string_view_type t = usage.format;
-                std::bitset<FlagSetSize> usage_flag_set;
+                std::vector<bool> usage_flag_set(flag_set_size);
                 auto get_error = [&i, &t, &usage](std::string_view what, std::size_t offset = 0) -> define_error_ref {
                     return {what, i, t.data() - usage.format.data() + offset};
                 };
-                auto raise = [get_error](std::string_view what, std::size_t offset = 0) {
-                    return std::unexpected(define_error{Config, std::array{get_error(what, offset)}});
+                auto raise = [&config, get_error](std::string_view what, std::size_t offset = 0) {
+                    return std::unexpected(define_error{config, std::array{get_error(what, offset)}});
                 };
                 /// \param exclude: needs to be sorted
                 auto add_option =
-                [&tree, &t, raise] [[nodiscard]]
+                [&config, &tree, &t, raise] [[nodiscard]]
                 (parse_node_type type = option, std::size_t var_index = 0, std::span<string_view_type> exclude = {})
                 -> std::optional<std::unexpected<define_error>> {
-                    bool compound = t.starts_with(Config.specials.compound_open);
+                    bool compound = t.starts_with(config.specials.compound_open);
                     if (compound) {
-                        if (t.ends_with(Config.specials.compound_close)) [[likely]] {
-                            t.remove_prefix(Config.specials.compound_open.size());
-                            t.remove_suffix(Config.specials.compound_close.size());
+                        if (t.ends_with(config.specials.compound_close)) [[likely]] {
+                            t.remove_prefix(config.specials.compound_open.size());
+                            t.remove_suffix(config.specials.compound_close.size());
                         } else {
                             return raise("Unmatched '(' when declaring a compound option.");
                         }
                     }
                     std::size_t start_node_index = tree.size();
-                    auto rng = t | views::split(Config.specials.compound_divider);
+                    auto rng = t | views::split(config.specials.compound_divider);
                     if (rng.empty()) [[unlikely]] {
                         return raise("Option lists cannot be empty.");
                     }
                     auto it = rng.begin();
                     if (compound) {
-                        if (t.ends_with(Config.specials.var_capture)) {
-                            t.remove_suffix(Config.specials.var_capture.size());
-                            if (t.empty() || t.ends_with(Config.specials.compound_divider)) {
+                        if (t.ends_with(config.specials.var_capture)) {
+                            t.remove_suffix(config.specials.var_capture.size());
+                            if (t.empty() || t.ends_with(config.specials.compound_divider)) {
                                 if (var_index) [[likely]] {
                                     tree.push_back({
                                         .type = variable,
@@ -802,9 +2113,10 @@ namespace cmd {
                             return raise(
                                 "Using | in a non-compound option declaration. "
                                 "If you want to declare a compound option, enclose it with ().",
-                                t.find(Config.specials.compound_divider));
+                                t.find(config.specials.compound_divider));
                         }
                     }
+                    std::size_t choice_index = 0;
                     for (const auto& opt : rng) {
                         string_view_type opt_t{opt};
                         if (opt_t.empty()) [[unlikely]] {
@@ -812,7 +2124,7 @@ namespace cmd {
                                 "Options cannot be empty. Check if you have added a redundant delimiter ('|').",
                                 opt.data() - t.data());
                         }
-                        if (opt_t == Config.specials.var_capture) [[unlikely]] {
+                        if (opt_t == config.specials.var_capture) [[unlikely]] {
                             return raise(
                                 R"(A capture ("...") must be placed as the last option.)", opt.data() - t.data());
                         }
@@ -820,7 +2132,10 @@ namespace cmd {
                             return raise(
                                 "Variable option repeats an existing option in this position.", opt.data() - t.data());
                         }
-                        tree.push_back({.type = type, .option_name = string_view_type{opt}, .var_index = var_index});
+                        tree.push_back({
+                            .type = type, .option_name = string_view_type{opt}, .var_index = var_index,
+                            .choice_index = choice_index++
+                        });
                         tree.back().next_placeholder = tree.size();
                     }
                     tree.back().next_placeholder = 0;
@@ -835,22 +2150,22 @@ namespace cmd {
                     tree[current].next = tree.size();
                     std::swap(tree[current], tree[added_first]);
                 };
-                for (const auto& token : usage.format | views::split(Config.specials.delimiter)) {
+                for (const auto& token : usage.format | views::split(config.specials.delimiter)) {
                     t = string_view_type{token};
                     if (t.empty()) [[unlikely]] {
                         return raise("Options cannot be empty. Check if you have added a redundant delimiter (' ').");
                     }
-                    if (t.starts_with(Config.specials.flag_open)) {
-                        if (t.ends_with(Config.specials.flag_close)) [[likely]] {
-                            t.remove_prefix(Config.specials.flag_open.size());
-                            t.remove_suffix(Config.specials.flag_close.size());
+                    if (t.starts_with(config.specials.flag_open)) {
+                        if (t.ends_with(config.specials.flag_close)) [[likely]] {
+                            t.remove_prefix(config.specials.flag_open.size());
+                            t.remove_suffix(config.specials.flag_close.size());
                             if (!t.starts_with('-')) [[unlikely]] {
                                 return raise(
                                     "Flags must be enclosed with a single pair of '[' and ']' and start with '-'.");
                             }
-                            std::size_t eq_pos = t.find(Config.specials.equal);
+                            std::size_t eq_pos = t.find(config.specials.equal);
                             string_view_type flag_name = t.substr(0, eq_pos);
-                            std::size_t h = get_hash<Hash, FlagSetSize>(flag_name);
+                            std::size_t h = Hash{}(flag_name) % flag_set_size;
                             auto& flag = flag_set[h];
                             if (flag.defined()) {
                                 std::string_view what;
@@ -865,13 +2180,13 @@ namespace cmd {
                                         .usage_index = 0,
                                         .type = note
                                     }};
-                                    for (std::size_t& j = refs[1].usage_index; j < ranges::size(Config.usages); ++j) {
+                                    for (std::size_t& j = refs[1].usage_index; j < usage_size; ++j) {
                                         if (flag.defined_for[j]) {
-                                            refs[1].loc = flag.name.data() - Config.usages[j].format.data();
+                                            refs[1].loc = flag.name.data() - config.usages[j].format.data();
                                             break;
                                         }
                                     }
-                                    return std::unexpected(define_error{Config, refs});
+                                    return std::unexpected(define_error{config, refs});
                                 }
                             } else {
                                 flag.name = flag_name;
@@ -881,8 +2196,8 @@ namespace cmd {
                             if (eq_pos != t.npos) {
                                 string_view_type var_name = t.substr(eq_pos + 1);
                                 if (
-                                    var_name.starts_with(Config.specials.var_open) &&
-                                    var_name.ends_with(Config.specials.var_close)
+                                    var_name.starts_with(config.specials.var_open) &&
+                                    var_name.ends_with(config.specials.var_close)
                                 ) [[likely]] {
                                     var_name.remove_prefix(1); var_name.remove_suffix(1);
                                     flag.var_index_for[i] = add_var(var_name);
@@ -899,14 +2214,14 @@ namespace cmd {
                     if (ended) [[unlikely]] {
                         return raise("Declaring non-flag attributes after declaring the first flag.");
                     }
-                    if (t.starts_with(Config.specials.var_open)) {
-                        std::size_t var_start = Config.specials.var_open.size(),
-                        var_end = t.find(Config.specials.var_close, var_start);
+                    if (t.starts_with(config.specials.var_open)) {
+                        std::size_t var_start = config.specials.var_open.size(),
+                        var_end = t.find(config.specials.var_close, var_start);
                         if (var_end == t.npos) [[unlikely]] {
                             return raise("Unclosed < when declaring variable.");
                         }
                         const std::size_t var_index = add_var(t.substr(var_start, var_end - var_start));
-                        var_end += Config.specials.var_close.size();
+                        var_end += config.specials.var_close.size();
                         const parse_node_type type = (var_end == t.size()) ? variable : variable_option;
                         std::vector<string_view_type> prev_opts;
                         bool insert = false;
@@ -941,14 +2256,15 @@ namespace cmd {
                                         {
                                             .what = "Previous variable declared here.",
                                             .usage_index = usage_index,
-                                            .loc = var_name.data() - Config.usages[usage_index].format.data(),
+                                            .loc = var_name.data() - config.usages[usage_index].format.data(),
                                             .type = note
                                         }
                                     };
-                                    return std::unexpected(define_error{Config, refs});
+                                    return std::unexpected(define_error{config, refs});
                                 }
                                 case variadic:
-                                case end: {
+                                case end:
+                                case delegate: {
                                     insert = true;
                                     break;
                                 }
@@ -963,11 +2279,11 @@ namespace cmd {
                             });
                         } else {
                             t.remove_prefix(var_end);
-                            if (!t.starts_with(Config.specials.equal)) [[unlikely]] {
+                            if (!t.starts_with(config.specials.equal)) [[unlikely]] {
                                 return raise("Unexpected character after declaration of variable.");
                             }
-                            t.remove_prefix(Config.specials.equal.size());
-                            if (!t.starts_with(Config.specials.compound_open)) [[unlikely]] {
+                            t.remove_prefix(config.specials.equal.size());
+                            if (!t.starts_with(config.specials.compound_open)) [[unlikely]] {
                                 return raise("Expected '(' for declaration of a variable option.");
                             }
                             ranges::sort(prev_opts);
@@ -977,10 +2293,14 @@ namespace cmd {
                         }
                         if (insert) insert_before_end(added_first);
                         searching = false;
-                    } else if (t == Config.specials.variadic) {
+                    } else if (t == config.specials.variadic) {
                         end_type = variadic;
                         searching = false;
                         break;
+                    } else if (t == config.specials.delegate) {
+                        end_type = delegate;
+                        searching = false;
+                        break;
                     } else {
                         if (searching) {
                             while (true) {
@@ -1001,7 +2321,8 @@ namespace cmd {
                                     }
                                     case variable:
                                     case variadic:
-                                    case end: {
+                                    case end:
+                                    case delegate: {
                                         const std::size_t added_first = tree.size();
                                         if (auto res = add_option()) return *res;
                                         insert_before_end(added_first);
@@ -1028,7 +2349,11 @@ namespace cmd {
                     std::size_t offset = 0;
                     if (type == variadic) [[unlikely]] {
                         what = "Another usage takes variadic arguments in this position.";
-                        offset = -Config.specials.variadic.size();
+                        offset = -config.specials.variadic.size();
+                    }
+                    if (type == delegate) [[unlikely]] {
+                        what = "Another usage delegates to another parser in this position.";
+                        offset = -config.specials.delegate.size();
                     }
                     if (type == end) [[unlikely]] {
                         what = "Another usage ends in this position.";
@@ -1038,31 +2363,172 @@ namespace cmd {
                         std::array<define_error_ref, 2> refs = {get_error(what, t.size() + offset), {
                             .what = "Previously defined here.",
                             .usage_index = usage_index,
-                            .loc = Config.usages[usage_index].format.size() + offset,
+                            .loc = config.usages[usage_index].format.size() + offset,
                             .type = note
                         }};
-                        return std::unexpected(define_error{Config, refs});
+                        return std::unexpected(define_error{config, refs});
                     }
                 }
                 tree.push_back({.type = end_type, .usage_index = static_cast<std::size_t>(i)});
 #undef RAISE
             }
+            // a perfect hash set of variables, which is tried with growing tables and different multipliers
+            // \return usage index and location of the first declaration of variable `name`
+            if (!with_var_table) {
+                return compiled_usages<CharT>{std::move(tree), std::move(var_names), std::move(flag_set), {}, 0};
+            }
+            auto declared = [&config](string_view_type name) {
+                const auto& specials = config.specials;
+                std::basic_string<CharT> token;
+                token.append(specials.var_open).append(name).append(specials.var_close);
+                for (auto [k, usage] : config.usages | views::enumerate) {
+                    const std::size_t loc = usage.format.find(token);
+                    if (loc != string_view_type::npos) {
+                        return std::pair{static_cast<std::size_t>(k), loc + specials.var_open.size()};
+                    }
+                }
+                return std::pair{0uz, 0uz};
+            };
+            for (std::size_t i = 1; i < var_names.size(); ++i) {
+                for (std::size_t j = 1; j < i; ++j) {
+                    if (Hash{}(var_names[i]) != Hash{}(var_names[j])) [[likely]] continue;
+                    const auto [usage_index, loc] = declared(var_names[i]);
+                    const auto [prev_usage_index, prev_loc] = declared(var_names[j]);
+                    return std::unexpected(define_error{config, std::array<define_error_ref, 2>{{
+                        {"Hash collision when declaring variable.", usage_index, loc},
+                        {"Previous variable defined here.", prev_usage_index, prev_loc, note}
+                    }}});
+                }
+            }
+            std::vector<std::size_t> var_table;
+            auto try_var_hash = [&var_names, &var_table](std::size_t table_size, std::uint64_t multiplier) {
+                var_table.assign(table_size, 0);
+                for (std::size_t i = 1; i < var_names.size(); ++i) {
+                    std::size_t& slot = var_table[get_var_slot<Hash>(var_names[i], multiplier, table_size)];
+                    if (slot) return false;
+                    slot = i;
+                }
+                return true;
+            };
+            std::uint64_t multiplier = 0;
+            // distinct hashes almost always fit well before this, unless they only differ in bits the slot drops
+            const std::size_t max_table_size = std::bit_ceil(var_names.size()) << var_table_max_growth;
+            for (std::size_t table_size = std::bit_ceil(var_names.size()); !multiplier; table_size *= 2) {
+                if (table_size > max_table_size) [[unlikely]] {
+                    const auto [usage_index, loc] = declared(var_names.back());
+                    return std::unexpected(define_error{config, std::array<define_error_ref, 1>{{
+                        {"Variables cannot be hashed to distinct slots; use another hasher.", usage_index, loc}
+                    }}});
+                }
+                for (std::uint64_t k = 0; k < 64; ++k) {
+                    if (try_var_hash(table_size, 0x9e3779b97f4a7c15 * (2 * k + 1))) {
+                        multiplier = 0x9e3779b97f4a7c15 * (2 * k + 1);
+                        break;
+                    }
+                }
+            }
+            return compiled_usages<CharT>{
+                std::move(tree), std::move(var_names), std::move(flag_set), std::move(var_table), multiplier
+            };
+        }
+        /// Profile of a parser defined without one.
+        inline constexpr std::array<std::uint64_t, 0> no_profile{};
+        /// Reorders the alternatives at each position of `tree` by descending `profile` counts.
+        /// Only options are reordered, and they are mutually exclusive,
+        /// so a command matches the same usage in either order.
+        /// \param profile: number of matches of each node, indexed like `tree`
+        /// \return index in the original `tree` of each node
+        template <char_like CharT>
+        constexpr std::vector<std::size_t> order_by_profile(std::vector<parse_node<CharT>>& tree, const auto& profile) {
+            using enum parse_node_type;
+            const std::vector<parse_node<CharT>> original = tree;
+            std::vector<std::size_t> origin(tree.size());
+            std::vector<bool> head(tree.size());
+            if (!tree.empty()) head[0] = true;
+            for (const auto& node : original) {
+                if (node.next) head[node.next] = true;
+            }
+            std::vector<std::size_t> slots, order;
+            for (std::size_t first = 0; first < original.size(); ++first) {
+                if (!head[first]) continue;
+                slots.clear();
+                for (std::size_t i = first; ; i = original[i].next_placeholder) {
+                    slots.push_back(i);
+                    if (!original[i].next_placeholder) break;
+                }
+                order = slots;
+                // the variable, variadic argument or end (if any) stays last
+                const auto options_end = ranges::find_if(order, [&original](std::size_t i) {
+                    return original[i].type != option && original[i].type != variable_option;
+                });
+                // insertion sort, which is stable (unlike `std::sort`) and constexpr (unlike `std::stable_sort`)
+                for (auto it = order.begin(); it != options_end; ++it) {
+                    for (auto j = it; j != order.begin() &&
+                        static_cast<std::uint64_t>(profile[*(j - 1)]) < static_cast<std::uint64_t>(profile[*j]); --j) {
+                        std::iter_swap(j - 1, j);
+                    }
+                }
+                for (std::size_t j = 0; j < slots.size(); ++j) {
+                    tree[slots[j]] = original[order[j]];
+                    tree[slots[j]].next_placeholder = j + 1 < slots.size() ? slots[j + 1] : 0;
+                    origin[slots[j]] = order[j];
+                }
+            }
+            return origin;
+        }
+        template <const auto& Config, typename CharT, typename Hash, std::size_t FlagSetSize,
+            const auto& Profile = no_profile>
+        constexpr auto parse_usage(auto out) noexcept ->
+        std::expected<parser_def<std::remove_cvref_t<decltype(Config)>>, define_error> {
+            auto res = compile_usages<CharT, Hash>(Config, FlagSetSize, true);
+            if (!res) [[unlikely]] {
+                return std::unexpected(res.error());
+            }
+            std::vector<std::size_t> origin(res->tree.size());
+            if constexpr (ranges::size(Profile) == 0) {
+                for (std::size_t i = 0; i < origin.size(); ++i) origin[i] = i;
+            } else {
+                if (ranges::size(Profile) != res->tree.size()) [[unlikely]] {
+                    return std::unexpected(define_error{Config, std::array{define_error_ref{
+                        "The profile does not match the parse tree. Record it again for these usages.", 0, 0
+                    }}});
+                }
+                origin = order_by_profile(res->tree, Profile);
+            }
             if constexpr (!std::is_same_v<decltype(out), std::nullptr_t>) {
+                ranges::copy(origin, out->node_origin.begin());
                 ranges::copy(Config.usages, out->usages.begin());
-                ranges::copy(tree, out->tree.begin());
-                ranges::copy(var_names, out->var_names.begin());
-                ranges::copy(flag_set, out->flag_set.begin());
+                ranges::copy(res->tree, out->tree.begin());
+                ranges::copy(res->var_names, out->var_names.begin());
+                ranges::copy(res->var_table, out->var_table.begin());
+                for (auto [to, from] : views::zip(out->flag_set, res->flag_set)) {
+                    to.name = from.name;
+                    for (std::size_t j = 0; j < ranges::size(Config.usages); ++j) {
+                        to.defined_for[j] = from.defined_for[j];
+                        to.var_index_for[j] = from.var_index_for[j];
+                    }
+                }
             }
             return parser_def{
                 .usage_size = ranges::size(Config.usages),
-                .tree_size = tree.size(),
-                .vars_size = var_names.size(),
+                .tree_size = res->tree.size(),
+                .vars_size = res->var_names.size(),
                 .flag_set_size = FlagSetSize,
-                .var_num = var_names.size(),
+                .var_num = res->var_names.size(),
+                .var_table_size = res->var_table.size(),
+                .var_hash_multiplier = res->var_hash_multiplier,
                 .config = Config
             };
         }
     }
+    namespace detail {
+        /// \return whether `config.error_msgs` has a message for each `error_type` but `unknown_error`.
+        /// A custom array written before an error type was added leaves its message empty.
+        constexpr bool has_error_msgs(const auto& config) noexcept {
+            return ranges::none_of(config.error_msgs | views::take(error_types_n - 1),
+                [](const auto& msg) {return msg.empty();});
+        }
+    }
     template <config_instance auto& Config>
     using config_type_of = std::remove_cvref_t<decltype(Config)>::super_type;
     /// \tparam Config: parser configuration (in `config::type`)
@@ -1078,6 +2544,7 @@ namespace cmd {
         {Hash{}(str)} -> std::same_as<size_t>;
     }
     consteval auto define_parser() noexcept {
+        static_assert(detail::has_error_msgs(Config), "error_msgs lacks a message for an error_type.");
         using config_type = config_type_of<Config>;
         using result_type = config_type::result_type;
         using char_type = config_type::char_type;
@@ -1089,11 +2556,42 @@ namespace cmd {
         } else {
 #if __cpp_static_assert >= 202306L
             static_assert(false, res.error());
+#endif
+        }
+    }
+    /// Same as `define_parser<Config, FlagSetSize, Hash>`, except that the alternatives at each position
+    /// are tried from the most to the least frequent in `Profile`, which never changes the usage matched.
+    /// \tparam Profile: a `random_access_range` of counts per node, e.g. `node_profile::hits` (in `trace.hpp`)
+    /// of a parser with the same usages
+    template <
+        config_instance auto& Config,
+        const auto& Profile,
+        std::size_t FlagSetSize = 512,
+        typename Hash = hash<std::basic_string_view<typename config_type_of<Config>::char_type>>
+    >
+    requires ranges::random_access_range<decltype(Profile)> && ranges::sized_range<decltype(Profile)> && requires(
+        std::basic_string_view<typename config_type_of<Config>::char_type> str) {
+        {Hash{}(str)} -> std::same_as<size_t>;
+    }
+    consteval auto define_parser() noexcept {
+        static_assert(detail::has_error_msgs(Config), "error_msgs lacks a message for an error_type.");
+        using char_type = config_type_of<Config>::char_type;
+        constexpr auto res = detail::parse_usage<Config, char_type, Hash, FlagSetSize, Profile>(nullptr);
+        if constexpr (res) {
+            parser_info<*res, Hash> info;
+            detail::parse_usage<Config, char_type, Hash, FlagSetSize, Profile>(&info);
+            return info;
+        } else {
+#if __cpp_static_assert >= 202306L
+            static_assert(false, res.error());
 #endif
         }
     }
 }
 
+template <typename CharT, typename CharTraits>
+constexpr bool std::ranges::enable_borrowed_range<cmd::delimited_range<CharT, CharTraits>> = true;
+
 template <cmd::tagged<cmd::detail::usage_range_tag> Rng>
 struct std::formatter<Rng, typename Rng::format_char_type> {
     using char_type = Rng::char_type;
@@ -0,0 +1,226 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include "parser.hpp"
+#include "mapped_file.hpp"
+
+namespace cmd {
+    /// Where an argument of `response_args` comes from.
+    struct arg_origin {
+        /// Path of the response file, or empty for an argument given directly.
+        std::string_view file;
+        /// 1-based line and column (in bytes) of the argument in `file`, or 0 for an argument given directly.
+        std::size_t line = 0, column = 0;
+
+        constexpr bool operator==(const arg_origin&) const noexcept = default;
+    };
+
+    /// Arguments with response files (arguments of the form `@path`) replaced by their contents.
+    /// Response files are mapped into memory and split into arguments with the same rules as
+    /// `parser::parse(const Str&)`, except that `specials.enter` also separates arguments,
+    /// and that escaped separators are kept in the argument.
+    /// Arguments are views into the mappings, unless removing quotes and escapes
+    /// leaves them discontiguous, in which case they are copied.
+    /// \remark An argument from a response file is itself a response file if it starts with `@`
+    /// before quotes and escapes are removed, so `"@path"` and `\@path` are taken verbatim.
+    /// Relative paths are relative to the working directory.
+    /// A response file that includes itself, directly or not, fails with `error_type::response_file_too_deep`,
+    /// and one more than `max_files` in all fails with `error_type::limit_exceeded`,
+    /// so that response files that include each other many times cannot make the expansion grow exponentially.
+    class response_args {
+        std::vector<std::string_view> args_;
+        std::vector<arg_origin> origins_;
+        std::vector<mapped_file> files_;
+        /// \internal Paths, and arguments that cannot be viewed in place.
+        /// A deque never moves its elements, so views into them stay valid.
+        std::deque<std::string> strings_;
+        std::optional<error_type> error_;
+        std::size_t error_index_ = -1;
+        std::size_t max_depth_, max_files_;
+        /// \internal Indices in `files_` of the response files being expanded, outermost first.
+        std::vector<std::size_t> open_files_;
+
+        void push(std::string_view arg, arg_origin origin) {
+            args_.push_back(arg);
+            origins_.push_back(origin);
+        }
+        void fail(error_type err, std::string_view arg, arg_origin origin) {
+            error_ = err;
+            error_index_ = args_.size();
+            push(arg, origin);
+        }
+        /// Expands response file `arg` found at `origin`, which is nested in `depth` other response files.
+        void expand(std::string_view arg, arg_origin origin, std::size_t depth,
+                    const special_chars<char>& specials) {
+            if (depth >= max_depth_) {
+                fail(error_type::response_file_too_deep, arg, origin);
+                return;
+            }
+            if (files_.size() >= max_files_) [[unlikely]] {
+                fail(error_type::limit_exceeded, arg, origin);
+                return;
+            }
+            const std::string& path = strings_.emplace_back(arg.substr(1));
+            try {
+                files_.emplace_back(path.c_str());
+            } catch (const std::system_error&) {
+                fail(error_type::unreadable_response_file, arg, origin);
+                return;
+            }
+            const mapped_file& file = files_.back();
+            if (ranges::any_of(open_files_, [this, &file](std::size_t i) {return files_[i].same_file(file);})) {
+                // it would include itself without end
+                fail(error_type::response_file_too_deep, arg, origin);
+                return;
+            }
+            open_files_.push_back(files_.size() - 1);
+            const auto bytes = file.bytes();
+            const char* const begin = reinterpret_cast<const char*>(bytes.data());
+            const char* const end = begin + bytes.size();
+            using traits = std::char_traits<char>;
+            auto separates = [&specials](char c) {
+                return traits::eq(c, specials.delimiter) || traits::eq(c, specials.enter);
+            };
+            std::size_t line = 1, column = 1;
+            auto advance = [&specials, &line, &column](char c) {
+                if (traits::eq(c, specials.enter)) {
+                    ++line;
+                    column = 1;
+                } else {
+                    ++column;
+                }
+            };
+            const char* p = begin;
+            while (true) {
+                for (; p != end && separates(*p); ++p) advance(*p);
+                if (p == end) break;
+                const arg_origin token_origin{path, line, column};
+                const bool nested = traits::eq(*p, '@');
+                // the argument is [run_begin, run_end) until a character is not adjacent to the last one
+                const char *run_begin = p, *run_end = p;
+                std::string* copy = nullptr;
+                auto put = [&](const char* c) {
+                    if (copy) {
+                        copy->push_back(*c);
+                    } else if (run_begin == run_end || c == run_end) {
+                        if (run_begin == run_end) run_begin = c;
+                        run_end = c + 1;
+                    } else {
+                        copy = &strings_.emplace_back(run_begin, run_end);
+                        copy->push_back(*c);
+                    }
+                };
+                bool quote_open = false, escape = false;
+                for (; p != end && (quote_open || escape || !separates(*p)); advance(*p), ++p) {
+                    const char c = *p;
+                    if (escape) {
+                        escape = false;
+                    } else {
+                        if (traits::eq(specials.quote_open, specials.quote_close)) {
+                            if (traits::eq(c, specials.quote_open)) {
+                                quote_open = !quote_open;
+                                continue;
+                            }
+                        } else {
+                            if (traits::eq(c, specials.quote_open)) {
+                                quote_open = true;
+                                continue;
+                            }
+                            if (traits::eq(c, specials.quote_close)) {
+                                quote_open = false;
+                                continue;
+                            }
+                        }
+                        if (traits::eq(c, specials.escape)) {
+                            escape = true;
+                            continue;
+                        }
+                    }
+                    put(p);
+                }
+                const std::string_view token = copy ? std::string_view{*copy} :
+                    std::string_view{run_begin, static_cast<std::size_t>(run_end - run_begin)};
+                if (error_) {
+                    if (!token.empty()) push(token, token_origin);
+                } else if (quote_open || escape) [[unlikely]] {
+                    fail(error_type::open_special_character, token, token_origin);
+                } else if (nested) {
+                    expand(token, token_origin, depth + 1, specials);
+                } else if (!token.empty()) {
+                    push(token, token_origin);
+                }
+            }
+            open_files_.pop_back();
+        }
+    public:
+        /// \param args: an `input_range` of arguments, in which those starting with `@` are response files
+        /// \param specials: special characters that quote and escape in response files
+        /// \param max_depth: most response files that can be nested, including those in `args`
+        /// \param max_files: most response files that can be expanded in all
+        /// \remark Expansion stops at the first error, after which the remaining arguments are kept verbatim.
+        /// Arguments in `args` are viewed in place if they outlive `args`,
+        /// i.e. `Args` is a `borrowed_range` of views or of l-values.
+        template <typename Args>
+        requires RANGE_OF(Args, input_range, std::string_view)
+        response_args(Args&& args, const special_chars<char>& specials, std::size_t max_depth,
+                      std::size_t max_files) :
+            max_depth_{max_depth}, max_files_{max_files} {
+            constexpr bool borrow = ranges::borrowed_range<Args> &&
+                (std::is_lvalue_reference_v<ranges::range_reference_t<Args>> ||
+                    std::is_trivially_copyable_v<ranges::range_value_t<Args>>);
+            for (auto&& arg : args) {
+                std::string_view view{arg};
+                if (!borrow) view = strings_.emplace_back(view);
+                if (!error_ && view.starts_with('@')) {
+                    expand(view, {}, 0, specials);
+                } else {
+                    push(view, {});
+                }
+            }
+        }
+
+        auto begin() const noexcept {
+            return args_.begin();
+        }
+        auto end() const noexcept {
+            return args_.end();
+        }
+        std::size_t size() const noexcept {
+            return args_.size();
+        }
+        const std::string_view& operator[](std::size_t i) const noexcept {
+            return args_[i];
+        }
+        /// \param i: index of an argument, e.g. `error_loc::arg_loc`
+        /// \return where argument `i` comes from
+        const arg_origin& origin(std::size_t i) const noexcept {
+            return origins_[i];
+        }
+        /// \return the error that stopped the expansion, if any
+        std::optional<error_type> error() const noexcept {
+            return error_;
+        }
+        /// \return index of the argument that caused `error()`
+        std::size_t error_index() const noexcept {
+            return error_index_;
+        }
+    };
+
+    /// `response_files_type` of a `parser` that expands response files into `response_args`.
+    /// \tparam MaxDepth: most response files that can be nested
+    /// \tparam MaxFiles: most response files that can be expanded for one command
+    template <std::size_t MaxDepth = 8, std::size_t MaxFiles = 64>
+    requires (MaxDepth > 0 && MaxFiles > 0)
+    struct response_files {
+        template <typename Args>
+        static response_args expand(Args&& args, const special_chars<char>& specials) {
+            return {std::forward<Args>(args), specials, MaxDepth, MaxFiles};
+        }
+    };
+}
\ No newline at end of file
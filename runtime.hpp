@@ -0,0 +1,472 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+#include "parser.hpp"
+#include "mapped_file.hpp"
+#include "config_default.hpp"
+
+namespace cmd {
+    /// Configuration of a parser whose usages are only known at runtime (e.g. read from a file or a plugin).
+    /// The usages must outlive `compiled_tree::compile`, but not the compiled tree.
+    template <usage_id Result, char_like CharT = char, char_like FmtCharT = CharT>
+    struct runtime_config {
+        using super_type = config<Result, CharT, FmtCharT>;
+        std::span<const typename super_type::usage_type> usages;
+        special_chars<CharT> specials = super_type::config_default_type::specials;
+    };
+
+    /// Reasons for `compiled_tree::open` to reject its input.
+    enum class compiled_error {
+        truncated,
+        bad_magic,
+        unsupported_version,
+        byte_order_mismatch,
+        char_type_mismatch,
+        hash_mismatch,
+        corrupted
+    };
+
+    /// Binary format of a compiled tree. All integers are in native byte order,
+    /// and all offsets are from the start of the data, so it can be used wherever it is loaded or mapped.
+    namespace compiled_format {
+        constexpr std::array<char, 8> magic = {'C', 'M', 'D', 'T', 'R', 'E', 'E', '\0'};
+        constexpr std::uint32_t version = 3;
+        constexpr std::uint32_t byte_order = 0x01020304;
+
+        /// Offset and size (in characters) of a string in the string pool.
+        struct string_ref {
+            std::uint32_t offset, size;
+        };
+        struct header {
+            std::array<char, 8> magic;
+            std::uint32_t version, byte_order, char_size, reserved;
+            /// Hash of `hash_probe`, to check that the same hasher is used.
+            std::uint64_t hash_check;
+            std::uint64_t usage_count, node_count, var_count, flag_set_size;
+            /// Offsets of sections:
+            /// `usage_record[usage_count]`, `node_record[node_count]`, `string_ref[var_count]`,
+            /// `string_ref[flag_set_size]`, `std::uint32_t[flag_set_size][usage_count]`, `specials_record`
+            /// and the string pool.
+            std::uint64_t usages, nodes, vars, flags, flag_usages, specials, strings;
+            std::uint64_t strings_size, total_size;
+        };
+        struct usage_record {
+            string_ref format;
+            std::int64_t result;
+        };
+        struct node_record {
+            /// `parse_node_type`.
+            std::uint32_t type;
+            /// `var_index`, or `usage_index` for `variadic`, `end` and `delegate` nodes.
+            std::uint32_t index;
+            std::uint32_t next_placeholder, next;
+            string_ref option_name;
+        };
+        /// Entry of a flag in a usage: 0 if it is not defined, otherwise 1 + index of its variable (or 0).
+        using flag_usage_record = std::uint32_t;
+        struct specials_record {
+            std::array<std::uint32_t, 7> chars;
+            std::array<string_ref, 12> strings;
+        };
+        constexpr std::string_view hash_probe = "--cmd-tree-hash-probe";
+    }
+
+    /// A parse tree, variable names and flag set in the binary format of `compiled_format`,
+    /// viewed in place. Create the data with `compile`, and view it with `open`,
+    /// e.g. from a `mapped_file`. Used by `runtime_parser`.
+    /// \tparam CharT: input character type
+    /// \tparam Hash: hasher of flags, which must be the same for `compile` and `open`
+    /// \remark The viewed data must outlive the `compiled_tree` and all parsers using it.
+    template <char_like CharT = char, hasher<CharT> Hash = hash<std::basic_string_view<CharT>>>
+    class compiled_tree {
+    public:
+        using char_type = CharT;
+        using string_view_type = std::basic_string_view<char_type>;
+        using hash_type = Hash;
+    private:
+        std::span<const std::byte> data_;
+        compiled_format::header header_;
+        const char_type* strings_;
+        special_chars<char_type> specials_;
+
+        explicit compiled_tree(std::span<const std::byte> data, const compiled_format::header& header) noexcept :
+            data_{data}, header_{header},
+            strings_{reinterpret_cast<const char_type*>(data.data() + header.strings)} {}
+
+        template <typename T>
+        T load(std::uint64_t offset) const noexcept {
+            T value;
+            std::memcpy(&value, data_.data() + offset, sizeof(T));
+            return value;
+        }
+        string_view_type string(compiled_format::string_ref ref) const noexcept {
+            return {strings_ + ref.offset, ref.size};
+        }
+        static std::uint64_t probe_hash() noexcept {
+            std::array<char_type, compiled_format::hash_probe.size()> probe;
+            ranges::copy(compiled_format::hash_probe, probe.begin());
+            return hash_type{}(string_view_type{probe.data(), probe.size()});
+        }
+        /// \return whether all indices and strings of the data are in bounds,
+        /// and the tree has no cycle (which would make `detail::matcher` loop forever)
+        bool valid() const noexcept {
+            using enum parse_node_type;
+            auto valid_string = [this](compiled_format::string_ref ref) {
+                return ref.offset <= header_.strings_size && ref.size <= header_.strings_size - ref.offset;
+            };
+            for (std::size_t i = 0; i < header_.usage_count; ++i) {
+                if (!valid_string(load<compiled_format::usage_record>(
+                    header_.usages + i * sizeof(compiled_format::usage_record)).format)) return false;
+            }
+            for (std::size_t i = 0; i < header_.node_count; ++i) {
+                const auto node = load<compiled_format::node_record>(
+                    header_.nodes + i * sizeof(compiled_format::node_record));
+                if (node.type > std::to_underlying(delegate) || !valid_string(node.option_name) ||
+                    node.next_placeholder >= header_.node_count || node.next >= header_.node_count) return false;
+                // `detail::compile_usages` only links forward, and 0 (the root) means no link
+                if ((node.next_placeholder && node.next_placeholder <= i) || (node.next && node.next <= i)) {
+                    return false;
+                }
+                const auto type = static_cast<parse_node_type>(node.type);
+                const bool by_usage = type == variadic || type == end || type == delegate;
+                const std::size_t limit = by_usage ? header_.usage_count : header_.var_count;
+                if (type != option && node.index >= limit) return false;
+            }
+            for (std::size_t i = 0; i < header_.var_count; ++i) {
+                if (!valid_string(load<compiled_format::string_ref>(
+                    header_.vars + i * sizeof(compiled_format::string_ref)))) return false;
+            }
+            for (std::size_t i = 0; i < header_.flag_set_size; ++i) {
+                if (!valid_string(load<compiled_format::string_ref>(
+                    header_.flags + i * sizeof(compiled_format::string_ref)))) return false;
+            }
+            for (std::size_t i = 0; i < header_.flag_set_size * header_.usage_count; ++i) {
+                if (load<compiled_format::flag_usage_record>(
+                    header_.flag_usages + i * sizeof(compiled_format::flag_usage_record)) > header_.var_count) {
+                    return false;
+                }
+            }
+            const auto specials = load<compiled_format::specials_record>(header_.specials);
+            return ranges::all_of(specials.strings, valid_string);
+        }
+    public:
+        /// Builds the parse tree of `config` at runtime, and serializes it.
+        /// \param config: `runtime_config` or `config::type`
+        /// \param flag_set_size: size of hash set for flags
+        /// \return data in the format of `compiled_format`, or the error in the usages
+        static std::expected<std::vector<std::byte>, detail::define_error>
+        compile(const auto& config, std::size_t flag_set_size = 512) {
+            namespace format = compiled_format;
+            auto res = detail::compile_usages<char_type, hash_type>(config, flag_set_size);
+            if (!res) [[unlikely]] {
+                return std::unexpected(res.error());
+            }
+            const std::size_t usage_count = ranges::size(config.usages);
+            std::basic_string<char_type> strings;
+            auto add_string = [&strings](string_view_type str) {
+                const format::string_ref ref{
+                    static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(str.size())};
+                strings.append(str);
+                return ref;
+            };
+            auto align = [](std::uint64_t offset) {
+                return (offset + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+            };
+            format::header header{
+                .magic = format::magic,
+                .version = format::version,
+                .byte_order = format::byte_order,
+                .char_size = sizeof(char_type),
+                .reserved = 0,
+                .hash_check = probe_hash(),
+                .usage_count = usage_count,
+                .node_count = res->tree.size(),
+                .var_count = res->var_names.size(),
+                .flag_set_size = flag_set_size
+            };
+            header.usages = align(sizeof(format::header));
+            header.nodes = align(header.usages + usage_count * sizeof(format::usage_record));
+            header.vars = align(header.nodes + header.node_count * sizeof(format::node_record));
+            header.flags = align(header.vars + header.var_count * sizeof(format::string_ref));
+            header.flag_usages = align(header.flags + flag_set_size * sizeof(format::string_ref));
+            header.specials = align(
+                header.flag_usages + flag_set_size * usage_count * sizeof(format::flag_usage_record));
+            header.strings = align(header.specials + sizeof(format::specials_record));
+
+            std::vector<std::byte> out(header.strings);
+            auto store = [&out](std::uint64_t offset, const auto& value) {
+                std::memcpy(out.data() + offset, &value, sizeof(value));
+            };
+            for (auto [i, usage] : config.usages | views::enumerate) {
+                store(header.usages + i * sizeof(format::usage_record),
+                    format::usage_record{add_string(usage.format), static_cast<std::int64_t>(usage.name)});
+            }
+            for (auto [i, node] : res->tree | views::enumerate) {
+                const bool by_usage = node.type == parse_node_type::variadic ||
+                    node.type == parse_node_type::end || node.type == parse_node_type::delegate;
+                store(header.nodes + i * sizeof(format::node_record), format::node_record{
+                    .type = static_cast<std::uint32_t>(std::to_underlying(node.type)),
+                    .index = static_cast<std::uint32_t>(by_usage ? node.usage_index : node.var_index),
+                    .next_placeholder = static_cast<std::uint32_t>(node.next_placeholder),
+                    .next = static_cast<std::uint32_t>(node.next),
+                    .option_name = add_string(node.option_name)
+                });
+            }
+            for (auto [i, name] : res->var_names | views::enumerate) {
+                store(header.vars + i * sizeof(format::string_ref), add_string(name));
+            }
+            for (auto [i, flag] : res->flag_set | views::enumerate) {
+                store(header.flags + i * sizeof(format::string_ref), add_string(flag.name));
+                for (std::size_t j = 0; j < usage_count; ++j) {
+                    const format::flag_usage_record entry = flag.defined_for[j] ?
+                        static_cast<format::flag_usage_record>(flag.var_index_for[j] + 1) : 0;
+                    store(header.flag_usages + (i * usage_count + j) * sizeof(format::flag_usage_record), entry);
+                }
+            }
+            const auto& specials = config.specials;
+            store(header.specials, format::specials_record{
+                .chars = {
+                    static_cast<std::uint32_t>(specials.delimiter), static_cast<std::uint32_t>(specials.enter),
+                    static_cast<std::uint32_t>(specials.quote_open), static_cast<std::uint32_t>(specials.quote_close),
+                    static_cast<std::uint32_t>(specials.escape), static_cast<std::uint32_t>(specials.indicator),
+                    static_cast<std::uint32_t>(specials.separator)
+                },
+                .strings = {
+                    add_string(specials.compound_open), add_string(specials.compound_close),
+                    add_string(specials.compound_divider), add_string(specials.flag_open),
+                    add_string(specials.flag_close), add_string(specials.flag_prefix),
+                    add_string(specials.var_open), add_string(specials.var_close),
+                    add_string(specials.var_capture), add_string(specials.equal), add_string(specials.variadic),
+                    add_string(specials.delegate)
+                }
+            });
+            header.strings_size = strings.size();
+            header.total_size = header.strings + strings.size() * sizeof(char_type);
+            out.resize(header.total_size);
+            std::memcpy(out.data() + header.strings, strings.data(), strings.size() * sizeof(char_type));
+            store(0, header);
+            return out;
+        }
+        /// Views data from `compile`, after checking that it is complete and made for this `compiled_tree`.
+        /// Nothing is rebuilt or copied.
+        /// \param data: must be aligned to `alignof(std::max_align_t)`, like memory from `new` or `mmap`
+        static std::expected<compiled_tree, compiled_error> open(std::span<const std::byte> data) noexcept {
+            namespace format = compiled_format;
+            using enum compiled_error;
+            format::header header;
+            if (data.size() < sizeof(header)) [[unlikely]] {
+                return std::unexpected(truncated);
+            }
+            std::memcpy(&header, data.data(), sizeof(header));
+            if (header.magic != format::magic) [[unlikely]] return std::unexpected(bad_magic);
+            if (header.byte_order != format::byte_order) [[unlikely]] return std::unexpected(byte_order_mismatch);
+            if (header.version != format::version) [[unlikely]] return std::unexpected(unsupported_version);
+            if (header.char_size != sizeof(char_type)) [[unlikely]] return std::unexpected(char_type_mismatch);
+            if (header.hash_check != probe_hash()) [[unlikely]] return std::unexpected(hash_mismatch);
+            if (header.total_size > data.size()) [[unlikely]] return std::unexpected(truncated);
+            auto fits = [&header](std::uint64_t offset, std::uint64_t count, std::size_t size) {
+                return offset <= header.total_size && count <= (header.total_size - offset) / size;
+            };
+            if (
+                !header.node_count || !header.flag_set_size ||
+                !fits(header.usages, header.usage_count, sizeof(format::usage_record)) ||
+                !fits(header.nodes, header.node_count, sizeof(format::node_record)) ||
+                !fits(header.vars, header.var_count, sizeof(format::string_ref)) ||
+                !fits(header.flags, header.flag_set_size, sizeof(format::string_ref)) ||
+                header.usage_count > std::numeric_limits<std::uint64_t>::max() / header.flag_set_size ||
+                !fits(header.flag_usages, header.flag_set_size * header.usage_count, sizeof(format::flag_usage_record)) ||
+                !fits(header.specials, 1, sizeof(format::specials_record)) ||
+                !fits(header.strings, header.strings_size, sizeof(char_type)) ||
+                header.strings % alignof(char_type)
+            ) [[unlikely]] {
+                return std::unexpected(corrupted);
+            }
+            compiled_tree tree{data.first(header.total_size), header};
+            if (!tree.valid()) [[unlikely]] {
+                return std::unexpected(corrupted);
+            }
+            const auto specials = tree.template load<format::specials_record>(header.specials);
+            auto str = [&tree, &specials](std::size_t i) {return tree.string(specials.strings[i]);};
+            tree.specials_ = {
+                static_cast<char_type>(specials.chars[0]), static_cast<char_type>(specials.chars[1]),
+                static_cast<char_type>(specials.chars[2]), static_cast<char_type>(specials.chars[3]),
+                static_cast<char_type>(specials.chars[4]), static_cast<char_type>(specials.chars[5]),
+                str(0), str(1), str(2), str(3), str(4), str(5), str(6), str(7), str(8), str(9), str(10), str(11),
+                static_cast<char_type>(specials.chars[6])
+            };
+            return tree;
+        }
+
+        const special_chars<char_type>& specials() const noexcept {
+            return specials_;
+        }
+        /// \return node no. `i`, where node 0 is the root
+        parse_node<char_type> node(std::size_t i) const noexcept {
+            using enum parse_node_type;
+            const auto record = load<compiled_format::node_record>(header_.nodes + i * sizeof(compiled_format::node_record));
+            parse_node<char_type> node{
+                .type = static_cast<parse_node_type>(record.type),
+                .option_name = string(record.option_name),
+                .next_placeholder = record.next_placeholder,
+                .next = record.next
+            };
+            if (node.type == variadic || node.type == end || node.type == delegate) {
+                node.usage_index = record.index;
+            } else {
+                node.var_index = record.index;
+            }
+            return node;
+        }
+        std::size_t flag_slot(string_view_type name) const noexcept {
+            return hash_type{}(name) % header_.flag_set_size;
+        }
+        string_view_type flag_name(std::size_t slot) const noexcept {
+            return string(load<compiled_format::string_ref>(header_.flags + slot * sizeof(compiled_format::string_ref)));
+        }
+        bool flag_defined(std::size_t slot, string_view_type name, std::size_t usage_index) const noexcept {
+            return flag_name(slot) == name && flag_usage(slot, usage_index);
+        }
+        std::size_t flag_var_index(std::size_t slot, std::size_t usage_index) const noexcept {
+            const auto entry = flag_usage(slot, usage_index);
+            return entry ? entry - 1 : 0;
+        }
+        /// \return `compiled_format::flag_usage_record` of the flag in `slot` and usage no. `usage_index`
+        std::uint32_t flag_usage(std::size_t slot, std::size_t usage_index) const noexcept {
+            return load<compiled_format::flag_usage_record>(header_.flag_usages +
+                (slot * header_.usage_count + usage_index) * sizeof(compiled_format::flag_usage_record));
+        }
+        std::size_t usage_count() const noexcept {
+            return header_.usage_count;
+        }
+        string_view_type usage_format(std::size_t usage_index) const noexcept {
+            return string(load<compiled_format::usage_record>(
+                header_.usages + usage_index * sizeof(compiled_format::usage_record)).format);
+        }
+        /// \return `usage::name` of the usage, converted to `std::int64_t`
+        std::int64_t usage_result(std::size_t usage_index) const noexcept {
+            return load<compiled_format::usage_record>(
+                header_.usages + usage_index * sizeof(compiled_format::usage_record)).result;
+        }
+        std::size_t node_count() const noexcept {
+            return header_.node_count;
+        }
+        /// \remark Index 0 is not a variable, same as `parser_info::var_names`.
+        std::size_t var_count() const noexcept {
+            return header_.var_count;
+        }
+        string_view_type var_name(std::size_t var_index) const noexcept {
+            return string(load<compiled_format::string_ref>(
+                header_.vars + var_index * sizeof(compiled_format::string_ref)));
+        }
+        std::size_t flag_set_size() const noexcept {
+            return header_.flag_set_size;
+        }
+        /// \return the viewed data
+        std::span<const std::byte> data() const noexcept {
+            return data_;
+        }
+    };
+
+    /// A parser of usages defined at runtime, through a `compiled_tree`.
+    /// It uses the same matching loop as `parser`, but looks up nodes and flags in the compiled data.
+    /// \tparam Result: type for identifying usages, which must match that used by `compile`
+    /// \tparam CharT: input character type
+    /// \tparam Hash: hasher of flags
+    template <usage_id Result, char_like CharT = char, hasher<CharT> Hash = hash<std::basic_string_view<CharT>>>
+    class runtime_parser {
+    public:
+        using result_type = Result;
+        using char_type = CharT;
+        using string_type = std::basic_string<char_type>;
+        using string_view_type = std::basic_string_view<char_type>;
+        using tree_type = compiled_tree<char_type, Hash>;
+        using variadic_type = std::vector<string_type>;
+        struct parse_result {
+            result_type result;
+            std::size_t usage_index;
+            /// Same as `parser::part_parse_result::rest_loc`.
+            std::size_t rest_loc;
+        };
+        struct parse_error {
+            error_type type;
+            error_loc loc;
+        };
+        using return_type = std::expected<parse_result, parse_error>;
+    private:
+        friend detail::matcher;
+        struct vars_element {
+            string_type content{};
+            error_loc loc{};
+        };
+        tree_type tree_;
+        std::vector<vars_element> vars_;
+        std::vector<bool> flags_;
+        variadic_type variadic_{};
+
+        void capture(std::size_t var_index, string_view_type value, error_loc loc) {
+            vars_[var_index].content.assign(value);
+            vars_[var_index].loc = loc;
+        }
+        void choose(std::size_t, std::size_t) const noexcept {}
+        void reserve_variadic(std::size_t size) {
+            variadic_.reserve(size);
+        }
+        std::optional<std::size_t> push_variadic(string_view_type arg) {
+            variadic_.emplace_back(arg);
+            return std::nullopt;
+        }
+        void trace(trace_event, std::size_t, std::size_t) const noexcept {}
+    public:
+        explicit runtime_parser(const tree_type& tree) :
+            tree_{tree}, vars_(tree.var_count()), flags_(tree.flag_set_size()) {}
+
+        /// \param args: an `input_range` of arguments that form a command
+        template <typename Args>
+        requires RANGE_OF(Args, input_range, string_view_type)
+        return_type parse(Args&& args) {
+            auto raise = [](error_type err, std::size_t, error_loc loc) {
+                return return_type{std::unexpect, err, loc};
+            };
+            auto succeed = [this](std::size_t usage_index, std::size_t rest_loc) {
+                return return_type{std::in_place,
+                    static_cast<result_type>(tree_.usage_result(usage_index)), usage_index, rest_loc};
+            };
+            return detail::matcher::match(tree_, *this, args, raise, succeed);
+        }
+        /// \remark Same as `parser::parse(int, char**)`, the first argument is discarded.
+        return_type parse(int argc, char* argv[])
+        requires (std::same_as<char_type, char>) {
+            return parse(views::counted(argv + 1, argc - 1));
+        }
+        /// \return captured content of the variable, or `nullptr` if no variable is named `name`
+        const string_type* var(string_view_type name) const noexcept {
+            for (std::size_t i = 1; i < vars_.size(); ++i) {
+                if (tree_.var_name(i) == name) return &vars_[i].content;
+            }
+            return nullptr;
+        }
+        /// \return whether flag `name` is set
+        bool flag(string_view_type name) const noexcept {
+            const std::size_t slot = tree_.flag_slot(name);
+            return tree_.flag_name(slot) == name && flags_[slot];
+        }
+        const variadic_type& variadic() const noexcept {
+            return variadic_;
+        }
+        const tree_type& tree() const noexcept {
+            return tree_;
+        }
+        /// Clears all variables and flags, keeping their memory.
+        void reset() noexcept {
+            for (auto& var : vars_) var.content.clear();
+            flags_.assign(flags_.size(), false);
+            variadic_.clear();
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include "parser.hpp"
+
+namespace cmd {
+    /// Splits a script into commands, which are separated by `specials.separator` or `specials.enter`
+    /// outside quotes and escapes. Each command is split into arguments like `parser::parse(const Str&)`.
+    /// \tparam Parser: a `parser`
+    template <typename Parser>
+    class script_splitter {
+    public:
+        using char_type = Parser::char_type;
+        using char_traits_type = Parser::char_traits_type;
+        using allocator_type = Parser::allocator_type;
+        using args_type = Parser::args_type;
+        using tokenizer_type = Parser::tokenizer;
+        /// A command of a script.
+        struct command {
+            args_type args;
+            /// Whether a quote or an escape is still open at the end of the script.
+            bool open = false;
+            /// Whether the command crosses a limit in `config.limits`, in which case `args` is incomplete.
+            bool exceeded = false;
+        };
+    private:
+        tokenizer_type tokenizer_;
+        allocator_type allocator_;
+    public:
+        explicit constexpr script_splitter(const allocator_type& alloc = {}) :
+            tokenizer_{alloc}, allocator_{alloc} {}
+        /// \return whether `c` ends a command, which can then be taken by `take`
+        constexpr bool feed(char_type c) {
+            constexpr const auto& specials = Parser::config.specials;
+            if (!tokenizer_.open() &&
+                (char_traits_type::eq(c, specials.separator) || char_traits_type::eq(c, specials.enter))) {
+                return true;
+            }
+            tokenizer_.feed(c);
+            return false;
+        }
+        /// \return the command read so far, which is empty if the command has no arguments
+        constexpr command take() {
+            const bool open = tokenizer_.open();
+            auto tok = std::exchange(tokenizer_, tokenizer_type{allocator_});
+            auto args = tok.release_trimmed();
+            return {std::move(args), open, tok.exceeded};
+        }
+    };
+
+    /// An `input_range` of the results of the commands in a script, each parsed as it is reached.
+    /// Empty commands are skipped.
+    /// \tparam Parser: a `parser`
+    /// \tparam Source: provides `std::optional<command> next()`, which returns `std::nullopt` at the end
+    /// \remark As with `parser::parse`, each command overwrites the variables and flags of the parser,
+    /// so a result should be used before moving on to the next.
+    template <typename Parser, typename Source>
+    class script_results {
+    public:
+        using args_type = Parser::args_type;
+        using command = script_splitter<Parser>::command;
+        using result_type = decltype(std::declval<Parser&>().parse(std::declval<args_type>()));
+    private:
+        Parser& parser_;
+        Source source_;
+        std::optional<result_type> current_;
+
+        void advance() {
+            current_.reset();
+            while (auto cmd = source_.next()) {
+                if (cmd->exceeded) [[unlikely]] {
+                    const error_loc loc{cmd->args.size(), 0};
+                    current_.emplace(std::unexpect, error_type::limit_exceeded, std::move(cmd->args), loc);
+                    return;
+                }
+                if (cmd->open) [[unlikely]] {
+                    current_.emplace(std::unexpect, error_type::open_special_character, std::move(cmd->args));
+                    return;
+                }
+                if (!cmd->args.empty()) {
+                    current_.emplace(parser_.parse(std::move(cmd->args)));
+                    return;
+                }
+            }
+        }
+    public:
+        class iterator {
+            script_results* self_;
+        public:
+            using value_type = result_type;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(script_results* self) noexcept : self_{self} {}
+            result_type& operator*() const noexcept {
+                return *self_->current_;
+            }
+            iterator& operator++() {
+                self_->advance();
+                return *this;
+            }
+            void operator++(int) {
+                ++*this;
+            }
+            bool operator==(std::default_sentinel_t) const noexcept {
+                return !self_->current_;
+            }
+        };
+
+        template <typename... SourceArgs>
+        explicit script_results(Parser& parser, SourceArgs&&... args) :
+            parser_{parser}, source_{std::forward<SourceArgs>(args)...} {}
+        script_results(const script_results&) = delete;
+        script_results& operator=(const script_results&) = delete;
+
+        /// Parses the first command. Can only be called once.
+        iterator begin() {
+            advance();
+            return iterator{this};
+        }
+        std::default_sentinel_t end() const noexcept {
+            return {};
+        }
+    };
+
+    namespace detail {
+        /// Splits a script into commands on the calling thread, as they are needed.
+        template <typename Parser, typename Str>
+        class script_source {
+            using command = script_splitter<Parser>::command;
+            views::all_t<Str> str_;
+            ranges::iterator_t<views::all_t<Str>> current_;
+            script_splitter<Parser> splitter_;
+        public:
+            script_source(Str&& str, const Parser& parser) :
+                str_{views::all(std::forward<Str>(str))}, current_{ranges::begin(str_)},
+                splitter_{parser.get_allocator()} {}
+            std::optional<command> next() {
+                if (current_ == ranges::end(str_)) return std::nullopt;
+                for (; current_ != ranges::end(str_); ++current_) {
+                    if (splitter_.feed(*current_)) {
+                        ++current_;
+                        break;
+                    }
+                }
+                return splitter_.take();
+            }
+        };
+
+        /// Splits a script into commands on its own thread,
+        /// which stays up to `capacity` commands ahead of the caller.
+        /// \remark Commands are allocated with `alloc` on the thread, and freed on the caller's thread.
+        template <typename Parser, typename Str>
+        class pipelined_source {
+            using command = script_splitter<Parser>::command;
+            using allocator_type = Parser::allocator_type;
+            /// \internal State shared with the thread.
+            struct shared {
+                std::mutex mutex;
+                std::condition_variable not_empty, not_full;
+                std::deque<command> queue;
+                std::size_t capacity;
+                bool done = false, stopping = false;
+                std::exception_ptr error;
+            };
+            std::unique_ptr<shared> shared_;
+            std::thread thread_;
+        public:
+            pipelined_source(Str&& str, const allocator_type& alloc, std::size_t capacity) :
+                shared_{std::make_unique<shared>()} {
+                shared_->capacity = capacity ? capacity : 1;
+                thread_ = std::thread{[&s = *shared_, str = views::all(std::forward<Str>(str)),
+                                       alloc] mutable {
+                    script_splitter<Parser> splitter{alloc};
+                    auto push = [&s](command&& cmd) {
+                        std::unique_lock lock{s.mutex};
+                        s.not_full.wait(lock, [&s] {return s.queue.size() < s.capacity || s.stopping;});
+                        if (s.stopping) return false;
+                        s.queue.push_back(std::move(cmd));
+                        s.not_empty.notify_one();
+                        return true;
+                    };
+                    try {
+                        bool running = true;
+                        for (auto it = ranges::begin(str); running && it != ranges::end(str); ++it) {
+                            if (splitter.feed(*it)) running = push(splitter.take());
+                        }
+                        if (running) push(splitter.take());
+                    } catch (...) {
+                        std::lock_guard lock{s.mutex};
+                        s.error = std::current_exception();
+                    }
+                    std::lock_guard lock{s.mutex};
+                    s.done = true;
+                    s.not_empty.notify_one();
+                }};
+            }
+            ~pipelined_source() {
+                if (!thread_.joinable()) return;
+                {
+                    std::lock_guard lock{shared_->mutex};
+                    shared_->stopping = true;
+                }
+                shared_->not_full.notify_one();
+                thread_.join();
+            }
+            /// \throw the exception thrown while splitting the script, if any
+            std::optional<command> next() {
+                std::unique_lock lock{shared_->mutex};
+                shared_->not_empty.wait(lock, [this] {return !shared_->queue.empty() || shared_->done;});
+                if (shared_->queue.empty()) {
+                    if (shared_->error) std::rethrow_exception(std::exchange(shared_->error, nullptr));
+                    return std::nullopt;
+                }
+                command cmd = std::move(shared_->queue.front());
+                shared_->queue.pop_front();
+                shared_->not_full.notify_one();
+                return cmd;
+            }
+        };
+    }
+
+    /// Runs a script through `parser`, e.g. `for (auto& res : cmd::script(parser, text)) {...}`.
+    /// \param str: a `forward_range` of `char_type`, which is split into commands as they are reached
+    /// \return `script_results`, which takes ownership of `str` if it is an r-value, and borrows it otherwise
+    template <typename Parser, typename Str>
+    requires RANGE_OF(Str, forward_range, typename Parser::char_type)
+    auto script(Parser& parser, Str&& str) {
+        return script_results<Parser, detail::script_source<Parser, Str>>{parser, std::forward<Str>(str), parser};
+    }
+    /// Same as `script`, except that the script is split into commands on another thread,
+    /// so that splitting the next commands overlaps with handling the current one.
+    /// \param capacity: most commands split ahead of the caller
+    /// \param alloc: allocator of the commands, which is used from both threads
+    /// \remark `str` must not be modified until the results are destroyed.
+    /// \remark The allocator of `parser` is not used for commands, because it is used by `parse` at the same time,
+    /// and e.g. `std::pmr::monotonic_buffer_resource` is not thread-safe.
+    /// The default `alloc` is a default-constructed allocator, i.e. `std::pmr::get_default_resource()` for a
+    /// `pmr::parser`. Another resource given as `alloc` must be thread-safe (e.g. `std::pmr::synchronized_pool_resource`).
+    template <typename Parser, typename Str>
+    requires RANGE_OF(Str, forward_range, typename Parser::char_type)
+    auto pipelined_script(Parser& parser, Str&& str, std::size_t capacity = 64,
+                          const typename Parser::allocator_type& alloc = {}) {
+        return script_results<Parser, detail::pipelined_source<Parser, Str>>{
+            parser, std::forward<Str>(str), alloc, capacity};
+    }
+}
\ No newline at end of file
@@ -0,0 +1,382 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "parser.hpp"
+
+namespace cmd {
+    /// How messages are delimited on a stream.
+    enum class framing {
+        /// Each message ends with `config.specials.enter`.
+        line,
+        /// Each message is preceded by its size, as a 4-byte big-endian unsigned integer.
+        length_prefixed
+    };
+
+    /// Serves commands from local clients over a Unix domain socket.
+    /// One thread accepts connections and splits their input into commands.
+    /// Commands are parsed and handled by a fixed pool of workers, each owning a `parser` of the same `parser_info`.
+    /// Commands from a connection are always handled by the same worker,
+    /// so replies are sent in the order of the commands.
+    /// Replies use the same `framing` as commands.
+    /// In line framing, a reply that contains `specials.enter` would be read as several replies,
+    /// so it is replaced by an empty reply.
+    /// \tparam Parser: type of the `parser`
+    /// \remark Only available on Linux.
+    template <typename Parser>
+    requires std::same_as<typename Parser::char_type, char> && std::same_as<typename Parser::format_char_type, char>
+    class command_server {
+    public:
+        using parser_type = Parser;
+        using result_type = Parser::result_type;
+        using parse_return_type = decltype(std::declval<Parser&>().parse(std::declval<const std::string_view&>()));
+        using parse_result_type = parse_return_type::value_type;
+        using parse_error_type = parse_return_type::error_type;
+        /// Handles a command. Variables and flags can be read from the `parser` passed in.
+        /// \return reply to the client
+        using handler_type = std::function<std::string(const parse_result_type&, Parser&)>;
+        /// Handles a command that cannot be parsed.
+        /// \return reply to the client
+        using error_handler_type = std::function<std::string(const parse_error_type&)>;
+        struct options {
+            /// Path of the socket. It is removed when the server stops.
+            std::string path;
+            std::size_t workers = std::max(std::thread::hardware_concurrency(), 1u);
+            framing mode = framing::line;
+            /// Connections that send a longer command are closed.
+            std::size_t max_command_size = 1 << 16;
+            /// Connections with more commands waiting for a worker are closed,
+            /// which bounds the memory taken by a client that sends commands faster than they are handled.
+            std::size_t max_pending_commands = 1024;
+            /// Connections that do not read a reply within this time are closed,
+            /// so that a client that stops reading does not stall its worker.
+            std::chrono::milliseconds write_timeout{5000};
+        };
+    private:
+        static constexpr std::size_t header_size = 4, buffer_size = 4096, max_events = 64;
+        struct connection {
+            int fd;
+            /// \internal Only accessed by the I/O thread.
+            std::string buffer{};
+            /// Number of commands queued to the worker and not handled yet.
+            std::atomic<std::size_t> pending = 0;
+            /// Whether the connection has been dropped, after which its queued commands are skipped.
+            std::atomic<bool> dropped = false;
+            explicit connection(int fd) noexcept : fd{fd} {}
+            connection(const connection&) = delete;
+            connection& operator=(const connection&) = delete;
+            ~connection() {
+                ::close(fd);
+            }
+        };
+        struct job {
+            std::shared_ptr<connection> conn;
+            std::string command;
+        };
+        struct worker {
+            std::mutex mutex;
+            std::condition_variable ready;
+            std::deque<job> jobs;
+            bool closed = false;
+            std::thread thread;
+        };
+        options options_;
+        std::array<handler_type, Parser::info.usages.size()> handlers_{};
+        error_handler_type on_error_ = [](const parse_error_type& error) {
+            return std::string{Parser::config.error_msgs[std::to_underlying(error.type)]};
+        };
+        int listen_fd_ = -1, epoll_fd_ = -1, wake_fd_ = -1;
+        bool bound_ = false;
+        std::unique_ptr<worker[]> workers_;
+        std::thread io_thread_;
+        std::atomic<bool> stopping_ = false;
+
+        [[noreturn]] static void throw_errno(const char* what) {
+            throw std::system_error(errno, std::system_category(), what);
+        }
+        static bool watch(int epoll_fd, int fd) noexcept {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+        }
+        /// Writes all of `data` to `fd`, waiting while the socket buffer is full.
+        /// \param timeout: most time to wait in total
+        /// \return whether the write succeeded within `timeout`
+        static bool write_all(int fd, std::string_view data, std::chrono::milliseconds timeout) noexcept {
+            using clock = std::chrono::steady_clock;
+            const auto deadline = clock::now() + timeout;
+            while (!data.empty()) {
+                const ssize_t size = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+                if (size >= 0) {
+                    data.remove_prefix(size);
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - clock::now());
+                    if (left.count() <= 0) return false;
+                    pollfd p{.fd = fd, .events = POLLOUT, .revents = 0};
+                    const auto wait = std::min<std::int64_t>(left.count(), INT32_MAX);
+                    if (::poll(&p, 1, static_cast<int>(wait)) < 0 && errno != EINTR) return false;
+                } else if (errno != EINTR) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        /// Finds the first message in `data`.
+        /// \param message: set to the message found
+        /// \return number of bytes the message takes up in `data` (0 if it is incomplete),
+        /// or -1 if it is too long
+        std::size_t next_message(std::string_view data, std::string_view& message) const noexcept {
+            if (options_.mode == framing::line) {
+                const std::size_t size = data.find(Parser::config.specials.enter);
+                if (size == data.npos) {
+                    return data.size() > options_.max_command_size ? -1uz : 0;
+                }
+                if (size > options_.max_command_size) [[unlikely]] return -1;
+                message = data.substr(0, size);
+                return size + 1;
+            } else {
+                if (data.size() < header_size) return 0;
+                std::size_t size = 0;
+                for (unsigned char c : data.substr(0, header_size)) {
+                    size = (size << 8) | c;
+                }
+                if (size > options_.max_command_size) [[unlikely]] return -1;
+                if (data.size() < header_size + size) return 0;
+                message = data.substr(header_size, size);
+                return header_size + size;
+            }
+        }
+        /// Reads from `conn`, and queues all complete commands to its worker.
+        /// \return whether the connection is still open
+        bool receive(const std::shared_ptr<connection>& conn) {
+            std::array<char, buffer_size> buffer;
+            std::vector<job> jobs;
+            bool open = true;
+            while (open) {
+                const ssize_t size = ::read(conn->fd, buffer.data(), buffer.size());
+                if (size < 0) {
+                    if (errno == EINTR) continue;
+                    open = (errno == EAGAIN || errno == EWOULDBLOCK);
+                    break;
+                }
+                if (size == 0) {
+                    open = false;
+                    break;
+                }
+                conn->buffer.append(buffer.data(), size);
+                std::string_view data = conn->buffer;
+                std::string_view message;
+                while (const std::size_t used = next_message(data, message)) {
+                    if (used == -1uz) [[unlikely]] {
+                        open = false;
+                        break;
+                    }
+                    if (conn->pending.load(std::memory_order_relaxed) + jobs.size() >= options_.max_pending_commands)
+                        [[unlikely]] {
+                        conn->dropped = true;
+                        ::shutdown(conn->fd, SHUT_RDWR);
+                        jobs.clear();
+                        open = false;
+                        break;
+                    }
+                    jobs.push_back({conn, std::string{message}});
+                    data.remove_prefix(used);
+                }
+                conn->buffer.erase(0, conn->buffer.size() - data.size());
+            }
+            if (!jobs.empty()) {
+                conn->pending += jobs.size();
+                worker& w = workers_[conn->fd % options_.workers];
+                {
+                    std::lock_guard lock{w.mutex};
+                    ranges::move(jobs, std::back_inserter(w.jobs));
+                }
+                w.ready.notify_one();
+            }
+            return open;
+        }
+        /// Accepts all pending connections.
+        void accept_all(std::unordered_map<int, std::shared_ptr<connection>>& connections) {
+            while (true) {
+                const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                if (!watch(epoll_fd_, fd)) [[unlikely]] {
+                    ::close(fd);
+                    continue;
+                }
+                connections.insert_or_assign(fd, std::make_shared<connection>(fd));
+            }
+        }
+        /// Body of the I/O thread.
+        void serve() {
+            std::array<epoll_event, max_events> events;
+            std::unordered_map<int, std::shared_ptr<connection>> connections;
+            while (!stopping_.load(std::memory_order_relaxed)) {
+                const int n = epoll_wait(epoll_fd_, events.data(), max_events, -1);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+                for (const epoll_event& event : events | views::take(n)) {
+                    const int fd = event.data.fd;
+                    if (fd == wake_fd_) continue;
+                    if (fd == listen_fd_) {
+                        accept_all(connections);
+                        continue;
+                    }
+                    const auto it = connections.find(fd);
+                    if (it != connections.end() && !receive(it->second)) {
+                        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+                        connections.erase(it);
+                    }
+                }
+            }
+        }
+        /// Body of a worker thread.
+        void work(worker& w) {
+            Parser parser;
+            while (true) {
+                job j;
+                {
+                    std::unique_lock lock{w.mutex};
+                    w.ready.wait(lock, [&w] { return !w.jobs.empty() || w.closed; });
+                    if (w.jobs.empty()) return;
+                    j = std::move(w.jobs.front());
+                    w.jobs.pop_front();
+                }
+                --j.conn->pending;
+                if (j.conn->dropped.load(std::memory_order_relaxed)) continue;
+                std::string reply;
+                {
+                    const auto res = parser.parse(std::string_view{j.command});
+                    if (res) {
+                        if (const handler_type& handler = handlers_[res->usage_index]) {
+                            reply = handler(*res, parser);
+                        }
+                    } else {
+                        reply = on_error_(res.error());
+                    }
+                    parser.reset();
+                }
+                if (options_.mode == framing::line) {
+                    if (reply.contains(Parser::config.specials.enter)) [[unlikely]] reply.clear();
+                    reply.push_back(Parser::config.specials.enter);
+                } else {
+                    const auto size = static_cast<std::uint32_t>(reply.size());
+                    const char header[header_size] = {
+                        static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+                        static_cast<char>(size >> 8), static_cast<char>(size)
+                    };
+                    reply.insert(0, header, header_size);
+                }
+                if (!write_all(j.conn->fd, reply, options_.write_timeout)) [[unlikely]] {
+                    // the I/O thread sees the end of the stream and removes the connection
+                    j.conn->dropped = true;
+                    ::shutdown(j.conn->fd, SHUT_RDWR);
+                }
+            }
+        }
+    public:
+        explicit command_server(options opts) : options_{std::move(opts)} {
+            if (options_.workers == 0) options_.workers = 1;
+        }
+        command_server(const command_server&) = delete;
+        command_server& operator=(const command_server&) = delete;
+        ~command_server() {
+            stop();
+        }
+
+        /// Handles commands of all usages identified by `name` with `handler`.
+        /// Commands without a handler get an empty reply.
+        /// \remark Must be called before `start`.
+        command_server& on(result_type name, handler_type handler) {
+            for (auto [i, usage] : Parser::info.usages | views::enumerate) {
+                if (usage.name == name) handlers_[i] = handler;
+            }
+            return *this;
+        }
+        /// Replaces the default error handler, which replies with the message in `config.error_msgs`.
+        /// \remark Must be called before `start`.
+        command_server& on_error(error_handler_type handler) {
+            on_error_ = std::move(handler);
+            return *this;
+        }
+        /// Binds the socket and starts all threads.
+        /// \throw std::system_error if any system call fails
+        /// \throw std::invalid_argument if `path` is too long
+        void start() {
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            if (options_.path.size() >= sizeof(addr.sun_path)) {
+                throw std::invalid_argument("Socket path is too long.");
+            }
+            ranges::copy(options_.path, addr.sun_path);
+            listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listen_fd_ < 0) throw_errno("socket");
+            if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) throw_errno("bind");
+            bound_ = true;
+            if (listen(listen_fd_, SOMAXCONN) < 0) throw_errno("listen");
+            epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd_ < 0) throw_errno("epoll_create1");
+            wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd_ < 0) throw_errno("eventfd");
+            if (!watch(epoll_fd_, listen_fd_) || !watch(epoll_fd_, wake_fd_)) throw_errno("epoll_ctl");
+            workers_ = std::make_unique<worker[]>(options_.workers);
+            for (worker& w : std::span{workers_.get(), options_.workers}) {
+                w.thread = std::thread{[this, &w] { work(w); }};
+            }
+            io_thread_ = std::thread{[this] { serve(); }};
+        }
+        /// Stops accepting commands, waits for queued commands to be handled, and closes the socket.
+        void stop() {
+            if (io_thread_.joinable()) {
+                stopping_ = true;
+                const std::uint64_t one = 1;
+                (void)!::write(wake_fd_, &one, sizeof(one));
+                io_thread_.join();
+            }
+            if (workers_) {
+                for (worker& w : std::span{workers_.get(), options_.workers}) {
+                    {
+                        std::lock_guard lock{w.mutex};
+                        w.closed = true;
+                    }
+                    w.ready.notify_one();
+                    if (w.thread.joinable()) w.thread.join();
+                }
+                workers_.reset();
+            }
+            for (int* fd : {&wake_fd_, &epoll_fd_, &listen_fd_}) {
+                if (*fd >= 0) ::close(std::exchange(*fd, -1));
+            }
+            if (std::exchange(bound_, false)) ::unlink(options_.path.c_str());
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <vector>
+#include "parser.hpp"
+
+namespace cmd {
+    /// Statistics of the nodes at the same distance from the root of a parse tree.
+    struct position_stats {
+        /// Number of chains (nodes linked by `next_placeholder`) at this position.
+        std::size_t chains = 0;
+        /// Number of nodes in the longest chain.
+        std::size_t max_chain_length = 0;
+        /// Average number of nodes in a chain.
+        double average_chain_length = 0;
+    };
+
+    /// Limits on the cost of a parser, see `tree_stats::within`.
+    struct budget {
+        /// Limit of `tree_stats::worst_case_comparisons`.
+        std::size_t max_comparisons = -1;
+        /// Limit of `tree_stats::info_size`.
+        std::size_t max_info_size = -1;
+        /// Limit of `tree_stats::max_chain_length`.
+        std::size_t max_chain_length = -1;
+        /// Limit of `tree_stats::depth`.
+        std::size_t max_depth = -1;
+        /// Limit of `tree_stats::flag_load_factor`.
+        double max_flag_load_factor = 1;
+    };
+
+    /// Statistics of a parse tree, computed by `tree_stats_of`.
+    /// \tparam N: number of nodes in the tree, an upper bound of `depth`
+    template <std::size_t N>
+    struct tree_stats {
+        /// Number of nodes in `tree`.
+        std::size_t node_count = N;
+        /// Number of positions in the longest path from the root, including the end of a command.
+        std::size_t depth = 0;
+        /// Statistics of each position, of which only the first `depth` are meaningful.
+        std::array<position_stats, N> positions{};
+        /// Number of nodes in the longest chain at any position.
+        std::size_t max_chain_length = 0;
+        /// Average number of nodes in a chain over all positions.
+        double average_chain_length = 0;
+        /// Number of flags declared, and the size of the hash set they are in.
+        std::size_t flag_count = 0, flag_set_size = 0;
+        double flag_load_factor = 0;
+        /// Most slots looked up to find a flag. Collisions are rejected by `define_parser`,
+        /// so this is 1 when there are any flags.
+        std::size_t worst_flag_probe = 0;
+        /// `sizeof` the `parser_info`.
+        std::size_t info_size = 0;
+        /// Most option names compared to arguments for any command, excluding flags.
+        /// Each flag in a command costs another `comparisons_per_flag`.
+        std::size_t worst_case_comparisons = 0;
+        /// Nodes whose subtree (the node, the alternatives after it and all that follows them) repeats another one,
+        /// up to the usages that end in them, e.g. the `<b> <c>` of `x <b> <c>` and `y <b> <c>`.
+        /// Suffix sharing cannot merge them, since each usage has its own `end` node,
+        /// from which `parse` takes its usage index, flags and related usages.
+        /// \remark This only reports duplication: the tree keeps these nodes.
+        std::size_t repeated_tail_nodes = 0;
+        static constexpr std::size_t comparisons_per_flag = 1;
+
+        /// \return `worst_case_comparisons` for a command with `flags` flags
+        constexpr std::size_t worst_case_comparisons_with(std::size_t flags) const noexcept {
+            return worst_case_comparisons + flags * comparisons_per_flag;
+        }
+        /// \return whether all statistics are within the limits of `b`, e.g.
+        /// `static_assert(cmd::tree_stats_of<info>().within({.max_comparisons = 16}));`
+        constexpr bool within(const budget& b) const noexcept {
+            return worst_case_comparisons <= b.max_comparisons && info_size <= b.max_info_size &&
+                max_chain_length <= b.max_chain_length && depth <= b.max_depth &&
+                flag_load_factor <= b.max_flag_load_factor;
+        }
+    };
+
+    /// \tparam Info: parser information from `define_parser`
+    /// \return statistics of `Info.tree` and `Info.flag_set`
+    template <tagged<parser_info_tag> auto& Info>
+    consteval auto tree_stats_of() {
+        using enum parse_node_type;
+        constexpr std::size_t tree_size = Info.tree.size();
+        tree_stats<tree_size> res{};
+        // chains are identified by the index of their first node
+        auto chain_length = [](std::size_t start) {
+            std::size_t length = 1;
+            for (std::size_t i = start; Info.tree[i].next_placeholder; i = Info.tree[i].next_placeholder) ++length;
+            return length;
+        };
+        std::vector<std::size_t> chain_depth(tree_size, 0);
+        std::vector<std::size_t> level{0}, next_level;
+        std::size_t chains = 0;
+        for (std::size_t d = 0; !level.empty(); ++d) {
+            position_stats& position = res.positions[d];
+            std::size_t nodes = 0;
+            for (std::size_t start : level) {
+                const std::size_t length = chain_length(start);
+                nodes += length;
+                if (length > position.max_chain_length) position.max_chain_length = length;
+                for (std::size_t i = start; ; i = Info.tree[i].next_placeholder) {
+                    const std::size_t next = Info.tree[i].next;
+                    if (next && !chain_depth[next] && ranges::find(next_level, next) == next_level.end()) {
+                        chain_depth[next] = d + 1;
+                        next_level.push_back(next);
+                    }
+                    if (!Info.tree[i].next_placeholder) break;
+                }
+            }
+            position.chains = level.size();
+            position.average_chain_length = static_cast<double>(nodes) / level.size();
+            if (position.max_chain_length > res.max_chain_length) res.max_chain_length = position.max_chain_length;
+            res.average_chain_length += nodes;
+            chains += level.size();
+            res.depth = d + 1;
+            level = std::move(next_level);
+            next_level.clear();
+        }
+        res.average_chain_length /= chains;
+        // worst[start]: most comparisons from chain `start` to the end of a command
+        std::vector<std::size_t> worst(tree_size, 0);
+        for (std::size_t d = res.depth; d-- > 0;) {
+            for (std::size_t start = 0; start < tree_size; ++start) {
+                if ((start && !chain_depth[start]) || chain_depth[start] != d) continue;
+                std::size_t compared = 0, cost = 0;
+                for (std::size_t i = start; ; i = Info.tree[i].next_placeholder) {
+                    const auto& node = Info.tree[i];
+                    if (node.type == option || node.type == variable_option) ++compared;
+                    const std::size_t rest = node.next ? worst[node.next] : 0;
+                    if (compared + rest > cost) cost = compared + rest;
+                    if (!node.next_placeholder) break;
+                }
+                worst[start] = cost;
+            }
+        }
+        res.worst_case_comparisons = worst[0];
+        // nodes are in the same class if their subtrees are equal, except for usage indices
+        struct shape {
+            parse_node_type type;
+            decltype(Info.tree[0].option_name) option_name;
+            std::size_t var_index, next, next_placeholder;
+
+            constexpr bool operator==(const shape&) const noexcept = default;
+        };
+        std::vector<shape> shapes;
+        std::vector<std::size_t> class_of(tree_size, -1);
+        auto classify = [&shapes, &class_of](auto& self, std::size_t i) -> std::size_t {
+            if (class_of[i] != -1uz) return class_of[i];
+            const auto& node = Info.tree[i];
+            shape sh{node.type, {}, 0, -1uz, -1uz};
+            if (node.type == option || node.type == variable_option || node.type == variable) {
+                sh.option_name = node.option_name;
+                if (node.type != option) sh.var_index = node.var_index;
+                sh.next = self(self, node.next);
+            }
+            if (node.next_placeholder) sh.next_placeholder = self(self, node.next_placeholder);
+            const auto found = ranges::find(shapes, sh);
+            class_of[i] = found - shapes.begin();
+            if (found == shapes.end()) shapes.push_back(sh);
+            return class_of[i];
+        };
+        if (tree_size) classify(classify, 0);
+        res.repeated_tail_nodes = tree_size - shapes.size();
+        res.flag_set_size = Info.flag_set.size();
+        res.flag_count = ranges::count_if(Info.flag_set, [](const auto& flag) {return flag.defined();});
+        res.flag_load_factor = static_cast<double>(res.flag_count) / res.flag_set_size;
+        res.worst_flag_probe = res.flag_count ? 1 : 0;
+        res.info_size = sizeof(Info);
+        return res;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+// Allocation budget of the parse hot path.
+// Global `operator new` and a `std::pmr` resource count allocations around each call,
+// which are checked against the upper bounds below and written to `alloc_report.json`
+// (or the path in environment variable `ALLOC_REPORT`), so that a regression shows up as a diff.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE Allocation Test
+#include <boost/test/unit_test.hpp>
+#include <parser.hpp>
+#include <config_default.hpp>
+#include <cache.hpp>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <new>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+    std::atomic<std::size_t> new_count{0};
+
+    void* counted_new(std::size_t size, std::align_val_t align = std::align_val_t{alignof(std::max_align_t)}) {
+        ++new_count;
+        if (size == 0) size = 1;
+        void* p = static_cast<std::size_t>(align) > alignof(std::max_align_t) ?
+            std::aligned_alloc(static_cast<std::size_t>(align), (size + static_cast<std::size_t>(align) - 1) &
+                ~(static_cast<std::size_t>(align) - 1)) :
+            std::malloc(size);
+        if (!p) throw std::bad_alloc{};
+        return p;
+    }
+}
+
+void* operator new(std::size_t size) {
+    return counted_new(size);
+}
+void* operator new[](std::size_t size) {
+    return counted_new(size);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    return counted_new(size, align);
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return counted_new(size, align);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return counted_new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return counted_new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    /// Counts its allocations, which bypass `operator new` so that they are not counted twice.
+    class counting_resource : public std::pmr::memory_resource {
+    public:
+        std::size_t count = 0;
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t align) override {
+            ++count;
+            void* p = std::aligned_alloc(align, (bytes + align - 1) & ~(align - 1));
+            if (!p) throw std::bad_alloc{};
+            return p;
+        }
+        void do_deallocate(void* p, std::size_t, std::size_t) override {
+            std::free(p);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    /// Discards everything written to it, without allocating.
+    template <typename CharT>
+    struct null_buffer : std::basic_streambuf<CharT> {
+        using typename std::basic_streambuf<CharT>::int_type;
+        using typename std::basic_streambuf<CharT>::traits_type;
+        int_type overflow(int_type c) override {
+            return traits_type::not_eof(c);
+        }
+    };
+
+    /// Allocations made by a call, from global `operator new` and from a `counting_resource`.
+    struct allocations {
+        std::size_t global, pmr;
+    };
+
+    /// Measured allocations by call, written to the report at exit.
+    std::map<std::string, allocations> report;
+
+    struct report_writer {
+        ~report_writer() {
+            const char* path = std::getenv("ALLOC_REPORT");
+            std::ofstream out{path ? path : "alloc_report.json"};
+            out << '{';
+            for (const char* sep = ""; const auto& [name, a] : report) {
+                out << sep << '"' << name << "\":{\"global\":" << a.global << ",\"pmr\":" << a.pmr << '}';
+                sep = ",";
+            }
+            out << "}\n";
+        }
+    };
+    BOOST_TEST_GLOBAL_FIXTURE(report_writer);
+
+    /// \return allocations made by `f`, which are recorded in the report as `name`
+    template <typename F>
+    allocations measure(const std::string& name, counting_resource& resource, F&& f) {
+        resource.count = 0;
+        new_count = 0;
+        std::forward<F>(f)();
+        const allocations a{new_count, resource.count};
+        report[name] = a;
+        return a;
+    }
+}
+
+constexpr cmd::config<int>::type config{
+    .name = "Test application",
+    .description = "Test description.",
+    .usages = {
+        {"test arg1 arg2 [--test_flag=<var>]", 1},
+        {"test (arg3|arg4) (arg5|arg6) <var> [--test_flag=<var2>] [--bool_flag]", 2},
+        {"test <var>=(arg7|arg8) <var2>=(arg9|arg10|...) ...", 3},
+        {"", 4}
+    }
+};
+constexpr auto info = cmd::define_parser<config>();
+// the same usages for wide input and output
+constexpr cmd::config<int, wchar_t>::type wide_config{
+    .name = L"Test application",
+    .description = L"Test description.",
+    .usages = {
+        {L"test arg1 arg2 [--test_flag=<var>]", 1},
+        {L"test (arg3|arg4) (arg5|arg6) <var> [--test_flag=<var2>] [--bool_flag]", 2},
+        {L"test <var>=(arg7|arg8) <var2>=(arg9|arg10|...) ...", 3},
+        {L"", 4}
+    }
+};
+constexpr auto wide_info = cmd::define_parser<wide_config>();
+// the same usages for UTF-16 input, without an input stream of its own
+constexpr cmd::config<int, char16_t, char>::type u16_config{
+    .name = "Test application",
+    .description = "Test description.",
+    .usages = {
+        {u"test arg1 arg2 [--test_flag=<var>]", 1},
+        {u"test (arg3|arg4) (arg5|arg6) <var> [--test_flag=<var2>] [--bool_flag]", 2},
+        {u"test <var>=(arg7|arg8) <var2>=(arg9|arg10|...) ...", 3},
+        {u"", 4}
+    }
+};
+constexpr auto u16_info = cmd::define_parser<u16_config>();
+
+/// Upper bounds on the steady-state allocations of one call, i.e. after the same call has been made once.
+/// Variables and variadic arguments reuse their buffers, so only the arguments split from a string
+/// (or converted from `argv`) and the related usages of an error are allocated.
+/// Entries marked "libstdc++" are worked out from its growth policy (vectors double in capacity,
+/// and strings hold 16 bytes in place, terminator included, and double past that).
+/// \remark None of them has been measured by a run on a toolchain that builds this test yet,
+/// so a call is only checked not to allocate more; the report holds the measured counts.
+const std::map<std::string, allocations> budget{
+    {"default/parse(argc, argv)", {0, 0}},
+    {"default/parse(range)", {0, 0}},
+    {"default/parse(range) variadic", {0, 0}},
+    // libstdc++: 5 arguments, a vector of capacity 1, 2, 4 and 8, and a string of capacity 30 and 60
+    {"default/parse(const Str&)", {6, 0}},
+    // libstdc++: the line (held in place), 3 arguments, a vector of capacity 1, 2 and 4
+    {"default/readline()", {3, 0}},
+    // related usages
+    {"default/error", {1, 0}},
+    {"default/parse_cache hit", {0, 0}},
+    {"default/reset()", {0, 0}},
+    {"pmr/parse(argc, argv)", {0, 0}},
+    {"pmr/parse(range)", {0, 0}},
+    {"pmr/parse(range) variadic", {0, 0}},
+    // libstdc++: as default
+    {"pmr/parse(const Str&)", {0, 6}},
+    // libstdc++: as default
+    {"pmr/readline()", {0, 3}},
+    {"pmr/error", {0, 1}},
+    {"pmr/parse_cache hit", {0, 0}},
+    {"pmr/reset()", {0, 0}},
+    // libstdc++ holds up to 3 wchar_t in place, so every argument is allocated:
+    // the vector of 5 arguments, and 5 strings
+    {"wchar_t/parse(argc, argv)", {6, 0}},
+    {"wchar_t/parse(range)", {0, 0}},
+    {"wchar_t/parse(range) variadic", {0, 0}},
+    // libstdc++: a vector of capacity 1, 2, 4 and 8, and strings growing from 3 to 6 (3 times),
+    // to 48 (4 times) and to 24 (3 times)
+    {"wchar_t/parse(const Str&)", {14, 0}},
+    // libstdc++: the line growing from 3 to 24 (3 times), a vector of capacity 1, 2 and 4, and 3 strings
+    {"wchar_t/readline()", {9, 0}},
+    {"wchar_t/error", {1, 0}},
+    {"wchar_t/parse_cache hit", {0, 0}},
+    {"wchar_t/reset()", {0, 0}},
+    // libstdc++ holds up to 7 char16_t in place: the vector of 5 arguments, and 2 strings
+    {"char16_t/parse(argc, argv)", {3, 0}},
+    {"char16_t/parse(range)", {0, 0}},
+    {"char16_t/parse(range) variadic", {0, 0}},
+    // libstdc++: a vector of capacity 1, 2, 4 and 8, and strings growing from 7 to 56 (3 times) and to 14
+    {"char16_t/parse(const Str&)", {8, 0}},
+    // without an input stream for char16_t, the line is read as char and converted (libstdc++: 1 string),
+    // then split (a vector of capacity 1, 2 and 4)
+    {"char16_t/readline()", {4, 0}},
+    {"char16_t/error", {1, 0}},
+    {"char16_t/parse_cache hit", {0, 0}},
+    {"char16_t/reset()", {0, 0}}
+};
+/// Calls whose allocations are recorded in the report but not checked:
+/// `print()` formats through `std::format_to`, whose allocations are up to the standard library,
+/// and have not been observed on a toolchain that builds this test.
+const std::set<std::string> unchecked{"print()"};
+
+/// Runs every call on `parser`, whose allocations are recorded as `<kind>/<call>`.
+template <typename Parser>
+void check_budget(const std::string& kind, Parser& parser, counting_resource& resource) {
+    using char_type = Parser::char_type;
+    using string_type = std::basic_string<char_type>;
+    using string_view_type = std::basic_string_view<char_type>;
+    auto widen = [](std::string_view str) {
+        return string_type(str.begin(), str.end());
+    };
+    auto widen_all = [&widen](std::initializer_list<std::string_view> strs) {
+        std::vector<string_type> out;
+        for (const auto str : strs) out.push_back(widen(str));
+        return out;
+    };
+    std::array<char*, 6> argv{
+        const_cast<char*>("prog"), const_cast<char*>("test"), const_cast<char*>("arg3"), const_cast<char*>("arg6"),
+        const_cast<char*>("a value that does not fit in a small string"), const_cast<char*>("--bool_flag")
+    };
+    const auto arg_strs = widen_all({
+        "test", "arg1", "arg2", "--test_flag=a value that does not fit in a small string"
+    });
+    const auto variadic_strs = widen_all({"test", "arg8", "arg9", "a", "b", "c"});
+    const auto wrong_strs = widen_all({"test", "arg3", "arg4", "var"});
+    const std::vector<string_view_type> args(arg_strs.begin(), arg_strs.end());
+    const std::vector<string_view_type> variadic_args(variadic_strs.begin(), variadic_strs.end());
+    const std::vector<string_view_type> wrong_args(wrong_strs.begin(), wrong_strs.end());
+    const string_type command =
+        widen("test arg4 arg5 \"a value that does not fit in a small string\" --test_flag=x");
+    std::istringstream input{"test arg1 arg2\ntest arg1 arg2\n"};
+    std::wistringstream wide_input{L"test arg1 arg2\ntest arg1 arg2\n"};
+    null_buffer<char> discard;
+    null_buffer<wchar_t> wide_discard;
+    auto* const cin_buf = std::cin.rdbuf(input.rdbuf());
+    auto* const wcin_buf = std::wcin.rdbuf(wide_input.rdbuf());
+    auto* const cout_buf = std::cout.rdbuf(&discard);
+    auto* const wcout_buf = std::wcout.rdbuf(&wide_discard);
+    auto check = [&](const std::string& call, auto&& f) {
+        f();
+        parser.reset();
+        const std::string name = kind + "/" + call;
+        BOOST_TEST_CONTEXT(name) {
+            const allocations a = measure(name, resource, f);
+            if (!unchecked.contains(call)) {
+                const auto expected = budget.find(name);
+                BOOST_REQUIRE(expected != budget.end());
+                BOOST_CHECK_LE(a.global, expected->second.global);
+                BOOST_CHECK_LE(a.pmr, expected->second.pmr);
+            }
+        }
+        parser.reset();
+    };
+    check("parse(argc, argv)", [&] {BOOST_CHECK(parser.parse(argv.size(), argv.data()));});
+    check("parse(range)", [&] {BOOST_CHECK(parser.parse(args));});
+    check("parse(range) variadic", [&] {BOOST_CHECK(parser.parse(variadic_args));});
+    check("parse(const Str&)", [&] {BOOST_CHECK(parser.parse(command));});
+    check("readline()", [&] {BOOST_CHECK(parser.readline());});
+    check("error", [&] {BOOST_CHECK(!parser.parse(wrong_args));});
+    {
+        const auto err = parser.parse(wrong_args);
+        BOOST_REQUIRE(!err);
+        check("print()", [&] {err.error().print();});
+    }
+    {
+        cmd::parse_cache<Parser> cache{1};
+        check("parse_cache hit", [&] {BOOST_CHECK(cache.parse(parser, command));});
+    }
+    BOOST_CHECK(parser.parse(args));
+    check("reset()", [&] {parser.reset();});
+    std::cin.rdbuf(cin_buf);
+    std::wcin.rdbuf(wcin_buf);
+    std::cout.rdbuf(cout_buf);
+    std::wcout.rdbuf(wcout_buf);
+}
+
+BOOST_AUTO_TEST_SUITE(alloc_tests)
+BOOST_AUTO_TEST_CASE(default_allocator) {
+    counting_resource resource;
+    cmd::parser<info> parser;
+    check_budget("default", parser, resource);
+}
+BOOST_AUTO_TEST_CASE(pmr) {
+    counting_resource resource;
+    cmd::pmr::parser<info> parser{&resource};
+    check_budget("pmr", parser, resource);
+}
+BOOST_AUTO_TEST_CASE(wide) {
+    counting_resource resource;
+    cmd::parser<wide_info> parser;
+    check_budget("wchar_t", parser, resource);
+}
+BOOST_AUTO_TEST_CASE(u16) {
+    counting_resource resource;
+    cmd::parser<u16_info> parser;
+    check_budget("char16_t", parser, resource);
+}
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,9 +5,30 @@
 #include <boost/mpl/list.hpp>
 #include <parser.hpp>
 #include <config_default.hpp>
+#include <event_loop.hpp>
+#include <server.hpp>
+#include <cache.hpp>
+#include <metrics.hpp>
+#include <trace.hpp>
+#include <stats.hpp>
+#include <runtime.hpp>
+#include <response.hpp>
+#include <script.hpp>
 #include <print>
 #include <tuple>
+#include <map>
+#include <set>
 #include <codecvt>
+#include <memory_resource>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fstream>
+
+using namespace std::literals;
 
 #define CONCAT2(x, y) x ## y
 #define CONCAT(x, y) CONCAT2(x, y)
@@ -87,6 +108,173 @@ BOOST_ANON_TEST_CASE() {
     BOOST_CHECK(res.error().type == unknown_flag);
     std::println("{}", res.error());
 }
+// errors in flags after the first are located at the flag itself
+BOOST_ANON_TEST_CASE() {
+    auto unknown = parser.parse(std::string_view{"test arg1 arg2 --test_flag=x --unknown_flag"});
+    BOOST_REQUIRE(!unknown.has_value());
+    BOOST_CHECK(unknown.error().type == unknown_flag);
+    BOOST_CHECK_EQUAL(unknown.error().ref.loc.arg_loc, 4u);
+    parser.reset();
+    auto argument = parser.parse(std::string_view{"test arg3 arg5 var --test_flag=x --bool_flag=y"});
+    BOOST_REQUIRE(!argument.has_value());
+    BOOST_CHECK(argument.error().type == flag_does_not_accept_argument);
+    BOOST_CHECK_EQUAL(argument.error().ref.loc.arg_loc, 5u);
+    BOOST_CHECK_EQUAL(argument.error().ref.loc.in_arg_loc, 11u);
+}
+BOOST_ANON_TEST_CASE() {
+    const auto buffer = "test\0arg3\0arg5\0test var\0--bool_flag\0"sv;
+    static_assert(std::ranges::forward_range<cmd::delimited_range<char>>);
+    BOOST_CHECK((std::ranges::equal(cmd::delimited_range{buffer, '\0'},
+        std::array{"test"sv, "arg3"sv, "arg5"sv, "test var"sv, "--bool_flag"sv})));
+    BOOST_CHECK((std::ranges::equal(cmd::delimited_range{"a\0\0b"sv, '\0'}, std::array{"a"sv, ""sv, "b"sv})));
+    BOOST_CHECK(std::ranges::empty(cmd::delimited_range{""sv, '\0'}));
+    auto res = parser.parse(buffer, '\0');
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(res->result, 2);
+    BOOST_CHECK_EQUAL(parser.var("var"), "test var");
+    BOOST_CHECK(parser.flag("--bool_flag"));
+    parser.reset();
+    auto err = parser.parse("test\narg1\narg2\n--test_flag=x\n--bogus"sv, '\n');
+    BOOST_REQUIRE(!err.has_value());
+    BOOST_CHECK(err.error().type == unknown_flag);
+    BOOST_CHECK_EQUAL(err.error().ref.loc.arg_loc, 4u);
+}
+BOOST_ANON_TEST_CASE() {
+    constexpr const auto& res = parser.precompiled<"test arg4 arg6 \"test var\" --test_flag=x --bool_flag">();
+    static_assert(res.result == 2 && res.usage_index == 1);
+    static_assert(res.var("var") == "test var" && res.var("var2") == "x");
+    static_assert(res.flag("--bool_flag") && res.flag("--test_flag"));
+    static_assert(std::ranges::empty(res.variadic()));
+    constexpr const auto& variadic = cmd::parser<info>::precompiled<"test arg7 free a b">();
+    static_assert(variadic.var("var") == "arg7" && variadic.var("var2") == "free");
+    BOOST_CHECK((std::ranges::equal(variadic.variadic(), std::array{"a"sv, "b"sv})));
+    BOOST_CHECK(!variadic.flag("--bool_flag"));
+}
+BOOST_ANON_TEST_CASE() {
+    using packed_result = decltype(parser)::packed_result;
+    static_assert(std::is_trivially_copyable_v<packed_result>);
+    auto res = parser.parse("test arg4 arg6 \"test var\" --test_flag=x --bool_flag"sv);
+    BOOST_REQUIRE(res.has_value());
+    alignas(packed_result::alignment) std::array<std::byte, 512> buffer;
+    BOOST_CHECK(!parser.pack(*res, std::span{buffer}.first(parser.packed_size() - 1)));
+    const auto packed = parser.pack(*res, buffer);
+    BOOST_REQUIRE(packed);
+    BOOST_CHECK_EQUAL(packed->bytes().size(), parser.packed_size());
+    parser.reset();
+    alignas(packed_result::alignment) std::array<std::byte, 512> copy;
+    std::memcpy(copy.data(), buffer.data(), packed->bytes().size());
+    buffer.fill(std::byte{});
+    const packed_result moved{copy.data()};
+    BOOST_CHECK_EQUAL(moved.result(), 2);
+    BOOST_CHECK_EQUAL(moved.usage_index(), 1u);
+    BOOST_CHECK_EQUAL(moved.var("var"), "test var");
+    BOOST_CHECK_EQUAL(moved.var("var2"), "x");
+    BOOST_CHECK(moved.flag("--test_flag") && moved.flag("--bool_flag"));
+    BOOST_CHECK(std::ranges::empty(moved.variadic()));
+}
+BOOST_ANON_TEST_CASE() {
+    auto res = parser.parse("test arg8 arg9 a bb ccc"sv);
+    BOOST_REQUIRE(res.has_value());
+    const auto block = parser.pack(*res);
+    parser.reset();
+    const auto packed = block.get();
+    BOOST_CHECK_EQUAL(packed.result(), 3);
+    BOOST_CHECK_EQUAL(packed.var("var"), "arg8");
+    BOOST_CHECK_EQUAL(packed.var("var2"), "arg9");
+    BOOST_CHECK(!packed.flag("--test_flag"));
+    BOOST_CHECK((std::ranges::equal(packed.variadic(), std::array{"a"sv, "bb"sv, "ccc"sv})));
+}
+BOOST_ANON_TEST_CASE() {
+    static_assert(decltype(parser)::find_var("var2")->index == decltype(parser)::var_name{"var2"}.index);
+    static_assert(!decltype(parser)::find_var("") && !decltype(parser)::find_var("arg1"));
+    static_assert(!decltype(parser)::find_flag("") && !decltype(parser)::find_flag("-test_flag"));
+    auto res = parser.parse("test arg3 arg6 x --test_flag=y --bool_flag"sv);
+    BOOST_REQUIRE(res.has_value());
+    for (std::string name : {"var", "var2"}) {
+        const auto var = parser.find_var(name);
+        BOOST_REQUIRE(var);
+        BOOST_CHECK_EQUAL(parser.var(*var), name == "var" ? "x" : "y");
+    }
+    const auto flag = parser.find_flag(std::string{"--bool_flag"});
+    BOOST_REQUIRE(flag);
+    BOOST_CHECK(parser.flag(*flag));
+    std::map<std::string_view, std::string_view> vars(parser.captured_vars().begin(), parser.captured_vars().end());
+    BOOST_CHECK((vars == std::map<std::string_view, std::string_view>{{"var", "x"}, {"var2", "y"}}));
+    std::set<std::string_view> flags(parser.set_flags().begin(), parser.set_flags().end());
+    BOOST_CHECK((flags == std::set<std::string_view>{"--test_flag", "--bool_flag"}));
+    parser.reset();
+    BOOST_CHECK(std::ranges::empty(parser.captured_vars()) && std::ranges::empty(parser.set_flags()));
+}
+BOOST_ANON_TEST_CASE() {
+    BOOST_REQUIRE(parser.parse("test arg8 arg9 x"sv).has_value());
+    BOOST_CHECK_EQUAL(parser.choice("var"), 1u);
+    // a capture ("...") accepts any value, so <var2> does not record which option it matched
+    BOOST_CHECK_EQUAL(parser.choice<int>("var2"), -1);
+    parser.reset();
+    BOOST_REQUIRE(parser.parse("test arg7 free"sv).has_value());
+    BOOST_CHECK_EQUAL(parser.choice("var"), 0u);
+    parser.reset();
+    BOOST_CHECK_EQUAL(parser.choice("var"), -1uz);
+    // <var> of usage 2 is not a variable option
+    BOOST_REQUIRE(parser.parse("test arg3 arg5 arg7"sv).has_value());
+    BOOST_CHECK_EQUAL(parser.choice("var"), -1uz);
+}
+BOOST_ANON_TEST_CASE() {
+    auto dispatch = [](std::string_view command) {
+        auto res = parser.parse(command);
+        BOOST_REQUIRE(res.has_value());
+        const std::string out = parser.dispatch(*res,
+            [](std::optional<std::string_view> test_flag) {
+                return "1 " + std::string{test_flag.value_or("-")};
+            },
+            [](std::string_view var, std::optional<std::string_view> var2, bool bool_flag) {
+                return "2 " + std::string{var} + ' ' + std::string{var2.value_or("-")} + (bool_flag ? " set" : "");
+            },
+            [](std::string_view var, std::string_view var2, const auto& variadic) {
+                return "3 " + std::string{var} + ' ' + std::string{var2} + ' ' + std::to_string(variadic.size());
+            },
+            [] {return std::string{"4"};}
+        );
+        parser.reset();
+        return out;
+    };
+    BOOST_CHECK_EQUAL(dispatch("test arg1 arg2 --test_flag=x"), "1 x");
+    BOOST_CHECK_EQUAL(dispatch("test arg1 arg2"), "1 -");
+    BOOST_CHECK_EQUAL(dispatch("test arg4 arg5 v --bool_flag"), "2 v - set");
+    BOOST_CHECK_EQUAL(dispatch("test arg4 arg5 v --test_flag=y"), "2 v y");
+    BOOST_CHECK_EQUAL(dispatch("test arg8 free a b"), "3 arg8 free 2");
+    BOOST_CHECK_EQUAL(dispatch(""), "4");
+}
+BOOST_ANON_TEST_CASE() {
+    constexpr auto input = "test arg7 free 1 0042 1234567890123456 12345678901234567 18446744073709551616"sv;
+    std::vector<std::int64_t> ints;
+    const auto res = parser.parse(input, ints, "Invalid number.");
+    BOOST_REQUIRE(!res.has_value());
+    BOOST_CHECK(res.error().type == invalid_argument);
+    BOOST_CHECK_EQUAL(res.error().ref.loc.arg_loc, 7u);
+    BOOST_CHECK((std::ranges::equal(ints, std::array<std::int64_t, 4>{1, 42, 1234567890123456, 12345678901234567})));
+    std::vector<double> doubles;
+    BOOST_REQUIRE(parser.parse("test arg7 free 1 0042"sv, doubles, "Invalid number.").has_value());
+    BOOST_CHECK((std::ranges::equal(doubles, std::array{1.0, 42.0})));
+    BOOST_CHECK(parser.variadic().empty());
+    // out of range
+    std::vector<std::uint8_t> bytes;
+    const auto res_bytes = parser.parse(input, bytes, "Invalid number.");
+    BOOST_REQUIRE(!res_bytes.has_value());
+    BOOST_CHECK_EQUAL(res_bytes.error().ref.loc.arg_loc, 5u); // 1234567890123456
+    BOOST_CHECK_EQUAL(res_bytes.error().ref.loc.in_arg_loc, 0u);
+    std::vector<float> floats;
+    const auto bad = parser.parse("test arg7 free 1.5 2e3 3x"sv, floats, "Invalid number.");
+    BOOST_REQUIRE(!bad.has_value());
+    BOOST_CHECK_EQUAL(bad.error().ref.loc.arg_loc, 5u);
+    BOOST_CHECK_EQUAL(bad.error().ref.loc.in_arg_loc, 1u);
+    BOOST_CHECK_EQUAL(std::string_view{bad.error().what}, "Invalid number.");
+    // the variadic arguments are stored as strings again afterwards
+    parser.reset();
+    BOOST_REQUIRE(parser.parse("test arg7 free 1 2"sv).has_value());
+    BOOST_CHECK_EQUAL(parser.variadic().size(), 2u);
+    parser.reset();
+}
 BOOST_ANON_TEST_CASE() {
     std::string_view input = "test arg3 arg5 var --bool_flag=var";
     auto res = parser.parse(input);
@@ -126,6 +314,972 @@ BOOST_ANON_TEST_CASE() {
     BOOST_CHECK_EQUAL(parser.var("var"), "");
     BOOST_CHECK(!parser.flag("--test_flag"));
 }
+BOOST_ANON_TEST_CASE() {
+    decltype(parser)::parse_session session{parser};
+    session.feed("test ar"sv).feed("g1  arg2 --test_fl"sv).feed("ag=\"test "sv);
+    BOOST_CHECK(session.open());
+    session.feed("var\""sv);
+    auto res = session.finish();
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(res->result, 1);
+    BOOST_CHECK_EQUAL(res->args.size(), 4u);
+    BOOST_CHECK(parser.flag("--test_flag"));
+    BOOST_CHECK_EQUAL(parser.var("var"), "test var");
+}
+BOOST_ANON_TEST_CASE() {
+    decltype(parser)::parse_session session{parser};
+    session.feed("test "sv).push("arg3").push("arg6").feed(" \"\\\\test\""sv).push("--bool_flag");
+    auto res = session.finish();
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(res->result, 2);
+    BOOST_CHECK_EQUAL(parser.var("var"), "\\test");
+    BOOST_CHECK(parser.flag("--bool_flag"));
+}
+BOOST_ANON_TEST_CASE() {
+    decltype(parser)::parse_session session{parser};
+    session.feed("test arg1 \"arg2"sv);
+    auto res = session.finish();
+    BOOST_REQUIRE(!res.has_value());
+    BOOST_CHECK(res.error().type == open_special_character);
+    std::println("{}", res.error());
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(cache_tests, parse_tests_fixture)
+using enum cmd::error_type;
+BOOST_ANON_TEST_CASE() {
+    cmd::parse_cache<decltype(parser)> cache{2};
+    std::array<std::string_view, 5> inputs{
+        "test arg1 arg2 --test_flag=a", "test arg8 arg9 x y", "test arg1 arg2 --test_flag=a", "test arg3", ""
+    };
+    for (int round = 0; round < 2; ++round) {
+        for (std::string_view input : inputs) {
+            auto expected = parser.parse(input);
+            const auto state = parser.save();
+            parser.reset();
+            const auto& res = cache.parse(parser, input);
+            BOOST_REQUIRE_EQUAL(res.has_value(), expected.has_value());
+            if (res) {
+                BOOST_CHECK_EQUAL(res->usage_index, expected->usage_index);
+                BOOST_CHECK(res->args == expected->args);
+            } else {
+                BOOST_CHECK(res.error().type == expected.error().type);
+                BOOST_CHECK_EQUAL(res.error().ref.loc.arg_loc, expected.error().ref.loc.arg_loc);
+                BOOST_CHECK(res.error().refs == expected.error().refs);
+            }
+            const auto cached_state = parser.save();
+            for (auto [var, expected_var] : std::views::zip(cached_state.vars, state.vars)) {
+                BOOST_CHECK_EQUAL(var.content, expected_var.content);
+                BOOST_CHECK_EQUAL(var.loc.arg_loc, expected_var.loc.arg_loc);
+            }
+            BOOST_CHECK(cached_state.flags == state.flags);
+            BOOST_CHECK(cached_state.variadic == state.variadic);
+            parser.reset();
+        }
+    }
+    BOOST_CHECK_EQUAL(cache.hits() + cache.misses(), 10u);
+    BOOST_CHECK_EQUAL(cache.hits(), 2u);
+    BOOST_CHECK_EQUAL(cache.size(), 2u);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(pmr_tests)
+using enum cmd::error_type;
+// parsed in constant evaluation, where a `std::pmr` allocator cannot be used
+BOOST_ANON_TEST_CASE() {
+    constexpr const auto& res = cmd::pmr::parser<info>::precompiled<"test arg3 arg5 x --bool_flag">();
+    static_assert(res.result == 2 && res.var("var") == "x" && res.flag("--bool_flag"));
+}
+BOOST_ANON_TEST_CASE() {
+    std::array<std::byte, 4096> buffer;
+    std::pmr::monotonic_buffer_resource resource{buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+    cmd::pmr::parser<info> pmr_parser{&resource};
+    std::string_view input = "test arg3 arg6 \"a variable long enough to not fit in a small string\"";
+    auto res = pmr_parser.parse(input);
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(res->result, 2);
+    BOOST_CHECK_EQUAL(pmr_parser.var("var"), "a variable long enough to not fit in a small string");
+    BOOST_CHECK(pmr_parser.var("var").get_allocator().resource() == &resource);
+    BOOST_CHECK(res->args.get_allocator().resource() == &resource);
+    pmr_parser.reset();
+    auto err = pmr_parser.parse(std::string_view{"test arg3 arg4"});
+    BOOST_REQUIRE(!err.has_value());
+    BOOST_CHECK(err.error().type == unknown_option);
+    BOOST_CHECK(err.error().refs.get_allocator().resource() == &resource);
+}
+/// Records whether it is used from a thread other than the one that created it.
+struct single_thread_resource : std::pmr::memory_resource {
+    std::thread::id owner = std::this_thread::get_id();
+    std::atomic<bool> shared = false;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (std::this_thread::get_id() != owner) shared = true;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        if (std::this_thread::get_id() != owner) shared = true;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+BOOST_ANON_TEST_CASE() {
+    single_thread_resource resource;
+    std::pmr::synchronized_pool_resource commands_resource;
+    cmd::pmr::parser<info> pmr_parser{&resource};
+    std::string script;
+    for (int i = 0; i < 64; ++i) script += "test arg3 arg6 \"a variable long enough to not fit in a small string\";";
+    std::size_t parsed = 0;
+    for (auto& res : cmd::pipelined_script(pmr_parser, script, 4, &commands_resource)) {
+        BOOST_REQUIRE(res.has_value());
+        BOOST_CHECK(res->args.get_allocator().resource() == &commands_resource);
+        ++parsed;
+    }
+    BOOST_CHECK_EQUAL(parsed, 64u);
+    // the splitter thread never touches the parser's resource
+    BOOST_CHECK(!resource.shared);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(subcommand_tests)
+using enum cmd::error_type;
+constexpr cmd::config<int>::type git_config{
+    .name = "git",
+    .usages = {
+        {"git commit ->", 1},
+        {"git push ->", 2},
+        {"git version", 3}
+    }
+};
+constexpr cmd::config<int>::type commit_config{
+    .name = "git commit",
+    .usages = {{"<message> [--amend]", 1}}
+};
+constexpr cmd::config<int>::type push_config{
+    .name = "git push",
+    .usages = {
+        {"<remote> (main|dev) [--force]", 1},
+        {"", 2}
+    }
+};
+constexpr auto git_info = cmd::define_parser<git_config, 1>();
+constexpr auto commit_info = cmd::define_parser<commit_config, 4>();
+constexpr auto push_info = cmd::define_parser<push_config, 4>();
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<git_info> git;
+    cmd::parser<commit_info> commit;
+    std::vector<std::string_view> args{"git", "commit", "hello", "--amend"};
+    auto res = git.parse(args);
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(res->result, 1);
+    BOOST_CHECK_EQUAL(res->rest_loc, 2u);
+    BOOST_REQUIRE(commit.parse(res->rest()).has_value());
+    BOOST_CHECK_EQUAL(commit.var("message"), "hello");
+    BOOST_CHECK(commit.flag("--amend"));
+    // child flags are unknown to the top-level parser
+    args = {"git", "version", "--amend"};
+    BOOST_CHECK(git.parse(args).error().type == unknown_flag);
+    args = {"git", "pull"};
+    BOOST_CHECK(git.parse(args).error().type == unknown_option);
+}
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<git_info> git;
+    cmd::parser<push_info> push;
+    // errors of a child are located in its own arguments
+    std::vector<std::string_view> args{"git", "push", "origin", "feature", "--force"};
+    auto res = git.parse(args);
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(res->result, 2);
+    auto push_res = push.parse(res->rest());
+    BOOST_REQUIRE(!push_res.has_value());
+    BOOST_CHECK(push_res.error().type == unknown_option);
+    BOOST_CHECK_EQUAL(push_res.error().ref.loc.arg_loc, 1u);
+    std::vector<std::string_view> bare{"git", "push"};
+    auto bare_res = git.parse(bare);
+    BOOST_REQUIRE(bare_res.has_value());
+    BOOST_CHECK(std::ranges::empty(bare_res->rest()));
+    BOOST_CHECK_EQUAL(push.parse(bare_res->rest()).value().result, 2);
+    std::vector<std::string_view> version{"git", "version"};
+    auto version_res = git.parse(version);
+    BOOST_REQUIRE(version_res.has_value());
+    BOOST_CHECK_EQUAL(version_res->rest_loc, 2u);
+    BOOST_CHECK(std::ranges::empty(version_res->rest()));
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(response_tests)
+using enum cmd::error_type;
+constexpr cmd::config<int>::type cc_config{
+    .name = "cc",
+    .usages = {{"cc <first> <second> <third> [--out=<out>]", 1}}
+};
+constexpr auto cc_info = cmd::define_parser<cc_config, 4>();
+struct response_policy : cmd::default_policy {
+    using response_files_type = cmd::response_files<>;
+};
+struct response_file {
+    std::string path, arg;
+    response_file(std::string_view name, std::string_view content) :
+        path{std::format("/tmp/command_line_parser_test_{}_{}.rsp", getpid(), name)}, arg{"@" + path} {
+        std::ofstream{path} << content;
+    }
+    ~response_file() {
+        unlink(path.c_str());
+    }
+};
+BOOST_ANON_TEST_CASE() {
+    response_file nested{"nested", "x\\ y.c\n"};
+    response_file outer{"outer", "a.c \"b c.c\"\n" + nested.arg + "\n--out=out.o\n"};
+    cmd::parser<cc_info, response_policy> cc;
+    std::vector<std::string_view> args{"cc", outer.arg};
+    auto res = cc.parse(args);
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(cc.var("first"), "a.c");
+    BOOST_CHECK_EQUAL(cc.var("second"), "b c.c");
+    BOOST_CHECK_EQUAL(cc.var("third"), "x y.c");
+    BOOST_CHECK_EQUAL(cc.var("out"), "out.o");
+    const cmd::response_args& expanded = res->args;
+    BOOST_REQUIRE_EQUAL(expanded.size(), 5u);
+    BOOST_CHECK(expanded.origin(0) == cmd::arg_origin{});
+    BOOST_CHECK((expanded.origin(2) == cmd::arg_origin{outer.path, 1, 5}));
+    BOOST_CHECK((expanded.origin(3) == cmd::arg_origin{nested.path, 1, 1}));
+    BOOST_CHECK((expanded.origin(4) == cmd::arg_origin{outer.path, 3, 1}));
+    // arguments without escapes are views into the mapped file
+    BOOST_CHECK_EQUAL(expanded[2].data()[expanded[2].size()], '"');
+    // without the policy, response files are taken verbatim
+    cmd::parser<cc_info> plain;
+    BOOST_CHECK(plain.parse(args).error().type == too_few_arguments);
+}
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<cc_info, response_policy> cc;
+    response_file flags{"flags", "a.c b.c c.c\n--bogus\n"};
+    std::vector<std::string_view> args{"cc", flags.arg};
+    auto res = cc.parse(args);
+    BOOST_REQUIRE(!res.has_value());
+    BOOST_CHECK(res.error().type == unknown_flag);
+    BOOST_CHECK((res.error().ref.args.origin(res.error().ref.loc.arg_loc) == cmd::arg_origin{flags.path, 2, 1}));
+    response_file self{"self", "a.c\n"};
+    std::ofstream{self.path} << "a.c\n" << self.arg;
+    args = {"cc", self.arg};
+    auto deep = cc.parse(args);
+    BOOST_REQUIRE(!deep.has_value());
+    BOOST_CHECK(deep.error().type == response_file_too_deep);
+    BOOST_CHECK((deep.error().ref.args.origin(deep.error().ref.loc.arg_loc) == cmd::arg_origin{self.path, 2, 1}));
+    response_file open{"open", "\"a.c"};
+    args = {"cc", open.arg};
+    BOOST_CHECK(cc.parse(args).error().type == open_special_character);
+    args = {"cc", "@/nonexistent/command_line_parser_test.rsp", "b.c", "c.c"};
+    auto missing = cc.parse(args);
+    BOOST_REQUIRE(!missing.has_value());
+    BOOST_CHECK(missing.error().type == unreadable_response_file);
+    BOOST_CHECK_EQUAL(missing.error().ref.loc.arg_loc, 1u);
+    BOOST_CHECK_EQUAL(missing.error().ref.args.size(), 4u);
+}
+// response files that include each other many times cannot make the expansion grow exponentially
+BOOST_ANON_TEST_CASE() {
+    struct deep_policy : cmd::default_policy {
+        using response_files_type = cmd::response_files<64>;
+    };
+    cmd::parser<cc_info, deep_policy> cc;
+    // a file including itself twice is caught at its first inclusion, however deep files may be nested
+    response_file self{"fan_out_self", ""};
+    std::ofstream{self.path} << "a.c " << self.arg << ' ' << self.arg;
+    std::vector<std::string_view> args{"cc", self.arg};
+    auto looped = cc.parse(args);
+    BOOST_REQUIRE(!looped.has_value());
+    BOOST_CHECK(looped.error().type == response_file_too_deep);
+    BOOST_CHECK((looped.error().ref.args.origin(looped.error().ref.loc.arg_loc) == cmd::arg_origin{self.path, 1, 5}));
+    // distinct files, each including the next twice, would be expanded 2^8 - 1 times
+    std::vector<std::unique_ptr<response_file>> files;
+    files.push_back(std::make_unique<response_file>("fan_out_7", "a.c"));
+    for (int i = 6; i >= 0; --i) {
+        const std::string& next = files.back()->arg;
+        files.push_back(std::make_unique<response_file>(std::format("fan_out_{}", i), next + ' ' + next));
+    }
+    args = {"cc", files.back()->arg};
+    cmd::parser<cc_info, response_policy> cc8;
+    auto fanned = cc8.parse(args);
+    BOOST_REQUIRE(!fanned.has_value());
+    BOOST_CHECK(fanned.error().type == limit_exceeded);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(script_tests)
+using enum cmd::error_type;
+constexpr std::string_view script =
+    "test arg1 arg2; test arg3 arg5 \"a;b\"\n\n test arg4 arg6 a\\;b --bool_flag ;test bogus; test \"open";
+template <typename Results>
+void check_script(Results&& results) {
+    std::vector<int> usages;
+    std::vector<std::string> vars;
+    std::vector<cmd::error_type> errors;
+    for (auto& res : results) {
+        if (res) {
+            usages.push_back(res->result);
+            vars.emplace_back(res->args.size() > 3 ? res->args[3] : "");
+        } else {
+            errors.push_back(res.error().type);
+        }
+    }
+    BOOST_CHECK((usages == std::vector{1, 2, 2}));
+    BOOST_CHECK((vars == std::vector<std::string>{"", "a;b", "a;b"}));
+    BOOST_CHECK((errors == std::vector{unknown_option, open_special_character}));
+}
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<info> p;
+    check_script(cmd::script(p, script));
+    auto empty = cmd::script(p, " ;\n; "sv);
+    static_assert(std::ranges::input_range<decltype(empty)>);
+    BOOST_CHECK(empty.begin() == empty.end());
+}
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<info> p;
+    check_script(cmd::pipelined_script(p, std::string{script}, 1));
+    // the results can be dropped before the script is split
+    auto results = cmd::pipelined_script(p, script, 1);
+    BOOST_CHECK((*results.begin())->result == 1);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(erased_tests)
+using enum cmd::error_type;
+struct erased_policy : cmd::default_policy {
+    static constexpr bool erased = true;
+    using tracer_type = cmd::ring_tracer<64>;
+};
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<info> inlined;
+    cmd::parser<info, erased_policy> erased;
+    for (std::string_view command : {
+        "test arg1 arg2 --test_flag=x"sv, "test arg3 arg6 value --bool_flag"sv, "test arg7 arg10 a b"sv, ""sv,
+        "test arg1 arg3"sv, "test arg4"sv, "test arg3 arg5 --x"sv, "test arg1 arg2 --bool_flag"sv,
+        "test arg3 arg5 v --bool_flag=1"sv, "test arg1 arg2 extra"sv
+    }) {
+        BOOST_TEST_CONTEXT(command) {
+            inlined.reset();
+            erased.reset();
+            erased.tracer().clear();
+            auto expected = inlined.parse(command);
+            auto res = erased.parse(command);
+            BOOST_REQUIRE_EQUAL(res.has_value(), expected.has_value());
+            BOOST_CHECK_GT(erased.tracer().total(), 0u);
+            if (res) {
+                BOOST_CHECK_EQUAL(res->usage_index, expected->usage_index);
+                BOOST_CHECK_EQUAL(erased.var("var"), inlined.var("var"));
+                BOOST_CHECK_EQUAL(erased.var("var2"), inlined.var("var2"));
+                BOOST_CHECK_EQUAL(erased.flag("--bool_flag"), inlined.flag("--bool_flag"));
+                BOOST_CHECK(erased.variadic() == inlined.variadic());
+            } else {
+                BOOST_CHECK(res.error().type == expected.error().type);
+                BOOST_CHECK_EQUAL(res.error().ref.loc.arg_loc, expected.error().ref.loc.arg_loc);
+                BOOST_CHECK_EQUAL(res.error().ref.loc.in_arg_loc, expected.error().ref.loc.in_arg_loc);
+                BOOST_CHECK(res.error().refs == expected.error().refs);
+            }
+        }
+    }
+    // compile-time parses do not go through the erased core
+    static_assert(cmd::parser<info, erased_policy>{}.parse("test arg1 arg2"sv)->usage_index == 0);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(limits_tests)
+using enum cmd::error_type;
+constexpr cmd::config<int>::type limited_config{
+    .usages = {
+        {"test arg1 arg2 [--test_flag=<var>]", 1},
+        {"test (arg3|arg4) (arg5|arg6) <var> [--test_flag=<var2>] [--bool_flag]", 2},
+        {"test <var>=(arg7|arg8) <var2>=(arg9|arg10|...) ...", 3}
+    },
+    .limits = {.command_size = 40, .args = 6, .arg_size = 24, .variadic = 2}
+};
+constexpr auto limited_info = cmd::define_parser<limited_config>();
+struct erased_policy : cmd::default_policy {
+    static constexpr bool erased = true;
+};
+template <typename Res>
+void check_exceeded(const Res& res, std::size_t arg_loc) {
+    BOOST_REQUIRE(!res.has_value());
+    BOOST_CHECK(res.error().type == limit_exceeded);
+    BOOST_CHECK_EQUAL(res.error().ref.loc.arg_loc, arg_loc);
+}
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<limited_info> p;
+    BOOST_CHECK(p.parse("test arg7 free a b"sv).has_value());
+    p.reset();
+    // too many variadic arguments
+    check_exceeded(p.parse("test arg7 free a b c"sv), 5);
+    p.reset();
+    // too many arguments, found while splitting
+    check_exceeded(p.parse("test arg7 free a b c d"sv), 6);
+    // too long, found while splitting
+    const auto long_command = "test arg3 arg5 0123456789abcdefghij --test_flag=0123456789"sv;
+    check_exceeded(p.parse(long_command), 4);
+    check_exceeded(p.parse("test arg3 arg5 0123456789abcdefghijklmnopqrstuvwxyz"sv), 3);
+    // the same limits on a range of arguments, in both matching cores
+    const std::vector<std::string_view> args{"test", "arg3", "arg5", "0123456789abcdefghij", "--test_flag=0123456789"};
+    check_exceeded(p.parse(args), 4);
+    cmd::parser<limited_info, erased_policy> erased;
+    check_exceeded(erased.parse(args), 4);
+    check_exceeded(erased.parse(std::vector{"test"sv, "arg7"sv, "free"sv, "a"sv, "b"sv, "c"sv, "d"sv}), 5);
+}
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<limited_info> p;
+    // quotes are still tracked after a limit is crossed, so the next command is found
+    std::vector<cmd::error_type> errors;
+    std::vector<int> usages;
+    for (auto& res : cmd::script(p, "test arg7 free a b c d \"e;f\"; test arg1 arg2"sv)) {
+        if (res) {
+            usages.push_back(res->result);
+        } else {
+            errors.push_back(res.error().type);
+        }
+    }
+    BOOST_CHECK((errors == std::vector{limit_exceeded}));
+    BOOST_CHECK((usages == std::vector{1}));
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(metrics_tests)
+using enum cmd::error_type;
+struct metrics_policy : cmd::default_policy {
+    using metrics_type = cmd::parse_metrics<info>;
+};
+BOOST_ANON_TEST_CASE() {
+    using metrics = metrics_policy::metrics_type;
+    metrics::reset();
+    cmd::parser<info, metrics_policy> measured_parser;
+    auto parse = [&measured_parser](std::string_view input) {
+        auto res = measured_parser.parse(input);
+        measured_parser.reset();
+        return res.has_value();
+    };
+    BOOST_CHECK(parse("test arg1 arg2"));
+    std::thread other{[&parse] {
+        BOOST_CHECK(parse("test arg1 arg2 --test_flag=x"));
+        BOOST_CHECK(!parse("test arg3 arg4"));
+    }};
+    other.join();
+    BOOST_CHECK(!parse("test \"arg1"));
+    auto snapshot = metrics::snapshot();
+    BOOST_CHECK_EQUAL(snapshot.usages[0], 2u);
+    BOOST_CHECK_EQUAL(snapshot.usages[1], 0u);
+    BOOST_CHECK_EQUAL(snapshot.errors[std::to_underlying(unknown_option)], 1u);
+    BOOST_CHECK_EQUAL(snapshot.errors[std::to_underlying(open_special_character)], 1u);
+    BOOST_CHECK_EQUAL(snapshot.total(), 4u);
+    std::string json;
+    snapshot.serialize(std::back_inserter(json));
+    BOOST_CHECK(json.starts_with(R"({"usages":[2,0,0,0],"errors":[1,0,0,0,0,0,1,0,0,0,0,0],"latency_ns_log2":[)"));
+    BOOST_CHECK(json.ends_with("]}"));
+    // hits of a cache are recorded as well
+    cmd::parse_cache<decltype(measured_parser)> cache{2};
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK(cache.parse(measured_parser, "test arg1 arg2").has_value());
+        measured_parser.reset();
+    }
+    BOOST_CHECK(!cache.parse(measured_parser, "test arg3 arg4").has_value());
+    BOOST_CHECK(!cache.parse(measured_parser, "test arg3 arg4").has_value());
+    measured_parser.reset();
+    snapshot = metrics::snapshot();
+    BOOST_CHECK_EQUAL(cache.hits(), 3u);
+    BOOST_CHECK_EQUAL(snapshot.usages[0], 5u);
+    BOOST_CHECK_EQUAL(snapshot.errors[std::to_underlying(unknown_option)], 3u);
+    BOOST_CHECK_EQUAL(snapshot.total(), 9u);
+    metrics::reset();
+    BOOST_CHECK_EQUAL(metrics::snapshot().total(), 0u);
+    // metrics are not recorded by parsers with the default policy
+    BOOST_CHECK(parser.parse("test arg1 arg2"sv).has_value());
+    parser.reset();
+    BOOST_CHECK_EQUAL(metrics::snapshot().total(), 0u);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_tests)
+using enum cmd::trace_event;
+template <typename Tracer>
+struct trace_policy : cmd::default_policy {
+    using tracer_type = Tracer;
+};
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<info, trace_policy<cmd::ring_tracer<64>>> traced_parser;
+    BOOST_REQUIRE(traced_parser.parse("test arg1 arg2 --test_flag=x"sv).has_value());
+    const auto& tracer = traced_parser.tracer();
+    BOOST_REQUIRE_GT(tracer.size(), 5u);
+    BOOST_CHECK(tracer[0] == (cmd::trace_record{node_visit, 0, 0}));
+    std::array<std::size_t, cmd::trace_events_n> counts{};
+    std::size_t last_arg = 0;
+    for (const cmd::trace_record& record : tracer.records()) {
+        ++counts[std::to_underlying(record.event)];
+        BOOST_CHECK_GE(record.arg, last_arg);
+        last_arg = record.arg;
+    }
+    BOOST_CHECK_EQUAL(counts[std::to_underlying(var_capture)], 1u);
+    BOOST_CHECK_EQUAL(counts[std::to_underlying(flag_lookup)], 1u);
+    BOOST_CHECK_EQUAL(counts[std::to_underlying(hash_probe)], 1u);
+    BOOST_CHECK(tracer[tracer.size() - 3].event == flag_lookup);
+    BOOST_CHECK(tracer[tracer.size() - 2].event == hash_probe);
+    BOOST_CHECK(tracer[tracer.size() - 1] == (cmd::trace_record{var_capture, tracer[tracer.size() - 3].node, 3}));
+    // only the latest steps are kept
+    cmd::parser<info, trace_policy<cmd::ring_tracer<2>>> small_parser;
+    BOOST_REQUIRE(small_parser.parse("test arg3 arg6 value"sv).has_value());
+    BOOST_CHECK_EQUAL(small_parser.tracer().size(), 2u);
+    BOOST_CHECK_GT(small_parser.tracer().total(), 2u);
+    BOOST_CHECK(small_parser.tracer()[1].event == node_visit);
+    BOOST_CHECK(small_parser.tracer()[0] == (cmd::trace_record{var_capture, small_parser.tracer()[0].node, 3}));
+}
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<info, trace_policy<cmd::chrome_tracer>> traced_parser;
+    BOOST_REQUIRE(!traced_parser.parse("test arg1 arg3"sv).has_value());
+    std::string json;
+    traced_parser.tracer().write(std::back_inserter(json));
+    BOOST_CHECK(json.starts_with(R"({"traceEvents":[{"name":"node_visit","ph":"i","s":"t","ts":)"));
+    BOOST_CHECK(json.ends_with("}}]}"));
+    BOOST_CHECK_EQUAL(traced_parser.tracer().size(), static_cast<std::size_t>(std::ranges::count(json, '{') - 1) / 2);
+}
+constexpr cmd::config<int>::type profiled_config{
+    .name = "profiled",
+    .usages = {
+        {"alpha <x>", 1},
+        {"beta (one|two)", 2},
+        {"gamma [--verbose]", 3},
+        {"beta three <y>", 4},
+        {"delta <y> ...", 5}
+    }
+};
+constexpr auto unprofiled_info = cmd::define_parser<profiled_config>();
+/// A profile where `delta` and then `three` are the most frequent.
+constexpr auto profile = [] {
+    std::array<std::uint64_t, unprofiled_info.tree.size()> hits{};
+    for (std::size_t i = 0; i < hits.size(); ++i) {
+        if (unprofiled_info.tree[i].option_name == "delta") hits[i] = 90;
+        if (unprofiled_info.tree[i].option_name == "three") hits[i] = 5;
+        if (unprofiled_info.tree[i].option_name == "alpha") hits[i] = 5;
+    }
+    return hits;
+}();
+constexpr auto profiled_info = cmd::define_parser<profiled_config, profile>();
+static_assert(profiled_info.tree[0].option_name == "delta");
+BOOST_ANON_TEST_CASE() {
+    cmd::parser<unprofiled_info, trace_policy<cmd::node_profile<unprofiled_info>>> unprofiled;
+    cmd::parser<profiled_info, trace_policy<cmd::node_profile<profiled_info>>> profiled;
+    for (auto command : {"delta a b c"sv, "beta three y"sv, "beta two"sv, "alpha x"sv, "gamma --verbose"sv,
+                         "beta"sv, "beta four"sv, "epsilon"sv, "delta"sv, ""sv}) {
+        const auto expected = unprofiled.parse(command);
+        const auto res = profiled.parse(command);
+        BOOST_TEST_CONTEXT(command) {
+            BOOST_REQUIRE_EQUAL(res.has_value(), expected.has_value());
+            if (res) {
+                BOOST_CHECK_EQUAL(res->usage_index, expected->usage_index);
+                BOOST_CHECK(std::ranges::equal(profiled.variadic(), unprofiled.variadic()));
+            } else {
+                BOOST_CHECK(res.error().type == expected.error().type);
+                BOOST_CHECK_EQUAL(res.error().ref.loc.arg_loc, expected.error().ref.loc.arg_loc);
+            }
+        }
+        unprofiled.reset();
+        profiled.reset();
+    }
+    // both record the same profile, indexed like the tree without a profile
+    BOOST_CHECK(profiled.tracer().hits() == unprofiled.tracer().hits());
+    const auto& hits = unprofiled.tracer().hits();
+    for (std::size_t i = 0; i < hits.size(); ++i) {
+        // a match is counted when the next argument is visited, which is not the case for "beta"
+        if (unprofiled_info.tree[i].option_name == "beta") BOOST_CHECK_EQUAL(hits[i], 3u);
+        if (unprofiled_info.tree[i].option_name == "delta") BOOST_CHECK_EQUAL(hits[i], 1u);
+        if (unprofiled_info.tree[i].option_name == "epsilon") BOOST_CHECK_EQUAL(hits[i], 0u);
+    }
+    std::string written;
+    unprofiled.tracer().write(std::back_inserter(written));
+    BOOST_CHECK_EQUAL(std::ranges::count(written, ','), static_cast<long>(hits.size() - 1));
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(stats_tests)
+constexpr cmd::config<int>::type stats_config{
+    .name = "Test application",
+    .usages = {
+        {"a (b|c) <x>", 1},
+        {"a d [--f]", 2}
+    }
+};
+constexpr auto stats_info = cmd::define_parser<stats_config, 16>();
+constexpr auto stats = cmd::tree_stats_of<stats_info>();
+static_assert(stats.within({.max_comparisons = 4, .max_info_size = sizeof(stats_info)}));
+static_assert(!stats.within({.max_comparisons = 3}));
+BOOST_ANON_TEST_CASE() {
+    BOOST_CHECK_EQUAL(stats.node_count, stats_info.tree.size());
+    BOOST_CHECK_EQUAL(stats.depth, 4u);
+    BOOST_CHECK_EQUAL(stats.positions[0].chains, 1u);
+    BOOST_CHECK_EQUAL(stats.positions[1].max_chain_length, 3u);
+    BOOST_CHECK_EQUAL(stats.positions[2].chains, 2u);
+    BOOST_CHECK_EQUAL(stats.positions[2].average_chain_length, 1.0);
+    BOOST_CHECK_EQUAL(stats.max_chain_length, 3u);
+    BOOST_CHECK_EQUAL(stats.worst_case_comparisons, 4u);
+    BOOST_CHECK_EQUAL(stats.worst_case_comparisons_with(2), 6u);
+    BOOST_CHECK_EQUAL(stats.flag_count, 1u);
+    BOOST_CHECK_EQUAL(stats.flag_set_size, 16u);
+    BOOST_CHECK_EQUAL(stats.flag_load_factor, 1.0 / 16);
+    BOOST_CHECK_EQUAL(stats.worst_flag_probe, 1u);
+    BOOST_CHECK_EQUAL(stats.info_size, sizeof(stats_info));
+    BOOST_CHECK_GE(cmd::tree_stats_of<info>().worst_case_comparisons, 3u);
+    // one of the two end nodes
+    BOOST_CHECK_EQUAL(stats.repeated_tail_nodes, 1u);
+}
+constexpr cmd::config<int>::type tails_config{
+    .name = "Test application",
+    .usages = {
+        {"x <b> <c>", 1},
+        {"y <b> <c>", 2},
+        {"z <b> (d|e)", 3}
+    }
+};
+constexpr auto tails_info = cmd::define_parser<tails_config, 16>();
+static_assert(cmd::tree_stats_of<tails_info>().repeated_tail_nodes == 4);
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(runtime_tests)
+using enum cmd::error_type;
+using tree_type = cmd::compiled_tree<char>;
+BOOST_ANON_TEST_CASE() {
+    // same usages as `config`, but only known at runtime
+    std::vector<std::string> formats;
+    std::vector<cmd::config<int>::usage_type> usages;
+    for (const auto& usage : config.usages) formats.emplace_back(usage.format);
+    for (std::size_t i = 0; i < formats.size(); ++i) usages.push_back({formats[i], config.usages[i].name});
+    auto blob = tree_type::compile(cmd::runtime_config<int>{.usages = usages});
+    BOOST_REQUIRE(blob.has_value());
+    formats.clear();
+    const std::string path = std::format("/tmp/command_line_parser_test_{}.tree", getpid());
+    std::ofstream{path, std::ios::binary}.write(reinterpret_cast<const char*>(blob->data()), blob->size());
+    cmd::mapped_file file{path.c_str()};
+    unlink(path.c_str());
+    auto tree = tree_type::open(file.bytes());
+    BOOST_REQUIRE(tree.has_value());
+    BOOST_CHECK_EQUAL(tree->node_count(), info.tree.size());
+    cmd::runtime_parser<int> runtime_parser{*tree};
+    for (std::string_view command : {
+        "test arg1 arg2 --test_flag=x"sv, "test arg3 arg6 value --bool_flag"sv, "test arg7 arg10 a b"sv, ""sv,
+        "test arg1 arg3"sv, "test arg4"sv, "test arg3 arg5 --x"sv, "test arg1 arg2 --bool_flag"sv,
+        "test arg3 arg5 v --bool_flag=1"sv, "test arg1 arg2 extra"sv
+    }) {
+        std::vector<std::string_view> args;
+        for (auto arg : command | std::views::split(' ')) args.emplace_back(arg);
+        BOOST_TEST_CONTEXT(command) {
+            auto expected = parser.parse(args);
+            auto res = runtime_parser.parse(args);
+            BOOST_REQUIRE_EQUAL(res.has_value(), expected.has_value());
+            if (res) {
+                BOOST_CHECK_EQUAL(res->result, expected->result);
+                BOOST_CHECK_EQUAL(res->usage_index, expected->usage_index);
+                BOOST_CHECK_EQUAL(*runtime_parser.var("var"), parser.var("var"));
+                BOOST_CHECK_EQUAL(*runtime_parser.var("var2"), parser.var("var2"));
+                BOOST_CHECK_EQUAL(runtime_parser.flag("--bool_flag"), parser.flag("--bool_flag"));
+                BOOST_CHECK(runtime_parser.variadic() == parser.variadic());
+            } else {
+                BOOST_CHECK(res.error().type == expected.error().type);
+                BOOST_CHECK_EQUAL(res.error().loc.arg_loc, expected.error().ref.loc.arg_loc);
+                BOOST_CHECK_EQUAL(res.error().loc.in_arg_loc, expected.error().ref.loc.in_arg_loc);
+            }
+        }
+        parser.reset();
+        runtime_parser.reset();
+    }
+    BOOST_CHECK(runtime_parser.var("unknown") == nullptr);
+}
+BOOST_ANON_TEST_CASE() {
+    using enum cmd::compiled_error;
+    const std::array<cmd::config<int>::usage_type, 1> usages{{{"test <var> [--flag]", 1}}};
+    auto blob = tree_type::compile(cmd::runtime_config<int>{.usages = usages}, 8);
+    BOOST_REQUIRE(blob.has_value());
+    BOOST_CHECK(tree_type::open(*blob).has_value());
+    BOOST_CHECK(tree_type::open(std::span{*blob}.first(blob->size() - 1)).error() == truncated);
+    BOOST_CHECK(tree_type::open(std::span{*blob}.first(8)).error() == truncated);
+    struct other_hash {
+        std::size_t operator()(std::string_view str) const {
+            return str.size();
+        }
+    };
+    BOOST_CHECK((cmd::compiled_tree<char, other_hash>::open(*blob).error() == hash_mismatch));
+    BOOST_CHECK(cmd::compiled_tree<wchar_t>::open(*blob).error() == char_type_mismatch);
+    auto corrupt = *blob;
+    corrupt[0] = std::byte{'X'};
+    BOOST_CHECK(tree_type::open(corrupt).error() == bad_magic);
+    corrupt = *blob;
+    corrupt[offsetof(cmd::compiled_format::header, version)] ^= std::byte{0xff};
+    BOOST_CHECK(tree_type::open(corrupt).error() == unsupported_version);
+    corrupt = *blob;
+    cmd::compiled_format::header header;
+    std::memcpy(&header, corrupt.data(), sizeof(header));
+    std::ranges::fill(std::span{corrupt}.subspan(header.nodes, sizeof(cmd::compiled_format::node_record)), std::byte{0xff});
+    BOOST_CHECK(tree_type::open(corrupt).error() == corrupted);
+    // a node linking to itself would make matching loop forever
+    corrupt = *blob;
+    cmd::compiled_format::node_record node;
+    std::byte* const second_node = corrupt.data() + header.nodes + sizeof(node);
+    std::memcpy(&node, second_node, sizeof(node));
+    node.next_placeholder = 1;
+    std::memcpy(second_node, &node, sizeof(node));
+    BOOST_CHECK(tree_type::open(corrupt).error() == corrupted);
+    // errors in usages are reported at runtime
+    const std::array<cmd::config<int>::usage_type, 1> bad_usages{{{"test (arg1|arg2", 1}}};
+    BOOST_CHECK(!tree_type::compile(cmd::runtime_config<int>{.usages = bad_usages}).has_value());
+    // the diagnostic of a long usage is truncated to its buffer
+    const std::string long_format = "test " + std::string(4000, 'a') + " (arg1|arg2";
+    const std::array<cmd::config<int>::usage_type, 1> long_usages{{{long_format, 1}}};
+    const auto long_error = tree_type::compile(cmd::runtime_config<int>{.usages = long_usages});
+    BOOST_REQUIRE(!long_error.has_value());
+    BOOST_CHECK_LE(long_error.error().size(), cmd::detail::define_error_buffer_size);
+}
+BOOST_ANON_TEST_CASE() {
+    const auto caret_at = [](std::size_t loc) {
+        return "| " + std::string(loc, ' ') + "^";
+    };
+    // variables whose hashes collide are located at their own declarations, not inside longer names
+    struct colliding_hash {
+        std::size_t operator()(std::string_view str) const {
+            return str.starts_with("var") ? 1 : str.size();
+        }
+    };
+    const std::array<cmd::config<int>::usage_type, 1> colliding{{{"test <var2> <var>", 1}}};
+    const cmd::runtime_config<int> colliding_config{.usages = colliding};
+    const auto collision = cmd::detail::compile_usages<char, colliding_hash>(colliding_config, 512, true);
+    BOOST_REQUIRE(!collision.has_value());
+    const std::string_view collision_what{collision.error().data(), collision.error().size()};
+    BOOST_CHECK(collision_what.contains(caret_at(6)) && collision_what.contains(caret_at(13)));
+    // distinct hashes that only differ in bits dropped by every slot never fit, so the search gives up
+    struct high_bit_hash {
+        std::size_t operator()(std::string_view str) const {
+            return str == "b" ? 1uz << 63 : 0;
+        }
+    };
+    const std::array<cmd::config<int>::usage_type, 1> unplaceable{{{"test <a> <b>", 1}}};
+    const cmd::runtime_config<int> unplaceable_config{.usages = unplaceable};
+    const auto unplaced = cmd::detail::compile_usages<char, high_bit_hash>(unplaceable_config, 512, true);
+    BOOST_REQUIRE(!unplaced.has_value());
+    const std::string_view unplaced_what{unplaced.error().data(), unplaced.error().size()};
+    BOOST_CHECK(unplaced_what.contains("distinct slots") && unplaced_what.contains(caret_at(10)));
+    // `runtime_parser` scans variables by name, so neither stops a tree from being compiled at runtime
+    const auto unplaced_tree = cmd::compiled_tree<char, high_bit_hash>::compile(unplaceable_config);
+    BOOST_REQUIRE(unplaced_tree.has_value());
+    const auto tree = cmd::compiled_tree<char, high_bit_hash>::open(*unplaced_tree);
+    BOOST_REQUIRE(tree.has_value());
+    cmd::runtime_parser<int, char, high_bit_hash> runtime{*tree};
+    BOOST_REQUIRE(runtime.parse(std::array{"test"sv, "x"sv, "y"sv}).has_value());
+    BOOST_CHECK(*runtime.var("b") == "y");
+    BOOST_CHECK((cmd::compiled_tree<char, colliding_hash>::compile(colliding_config).has_value()));
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(event_loop_tests)
+BOOST_ANON_TEST_CASE() {
+    cmd::event_loop loop{parser};
+    int a[2], b[2];
+    BOOST_REQUIRE(pipe(a) == 0 && pipe(b) == 0);
+    std::vector<int> a_results, b_results, closed;
+    auto on_command = [&](int fd, const auto& res) {
+        (fd == a[0] ? a_results : b_results).push_back(res ? res->result : -1);
+    };
+    auto on_close = [&](int fd, int error) {
+        BOOST_CHECK_EQUAL(error, 0);
+        closed.push_back(fd);
+    };
+    loop.add(a[0], on_command, on_close);
+    loop.add(b[0], on_command, on_close);
+    auto write_str = [](int fd, std::string_view str) {
+        BOOST_REQUIRE_EQUAL(write(fd, str.data(), str.size()), static_cast<ssize_t>(str.size()));
+    };
+    write_str(a[1], "test arg1 arg2\ntest ar");
+    write_str(b[1], "\n  \ntest arg7 arg11\n");
+    BOOST_CHECK_EQUAL(loop.poll(0), 2u);
+    BOOST_CHECK(a_results == std::vector{1});
+    BOOST_CHECK(b_results == std::vector{3});
+    write_str(a[1], "g1 arg2\ntest arg3");
+    close(a[1]);
+    close(b[1]);
+    loop.run();
+    BOOST_CHECK((a_results == std::vector{1, 1, -1}));
+    BOOST_CHECK(b_results == std::vector{3});
+    BOOST_CHECK_EQUAL(closed.size(), 2u);
+    BOOST_CHECK_EQUAL(loop.size(), 0u);
+    close(a[0]);
+    close(b[0]);
+}
+// a callback may add streams while the rest of the chunk it came from is still being dispatched
+BOOST_ANON_TEST_CASE() {
+    cmd::event_loop loop{parser};
+    int a[2];
+    BOOST_REQUIRE(pipe(a) == 0);
+    std::vector<std::array<int, 2>> added(64);
+    std::vector<int> results;
+    auto ignore = [](int, const auto&) {};
+    loop.add(a[0], [&](int, const auto& res) {
+        results.push_back(res ? res->result : -1);
+        if (results.size() == 1) {
+            // enough streams for `streams_` to rehash
+            for (auto& p : added) {
+                BOOST_REQUIRE(pipe(p.data()) == 0);
+                loop.add(p[0], ignore);
+            }
+        }
+    });
+    const std::string_view commands = "test arg1 arg2\ntest arg7 arg11\ntest arg3\n";
+    BOOST_REQUIRE_EQUAL(write(a[1], commands.data(), commands.size()), static_cast<ssize_t>(commands.size()));
+    BOOST_CHECK_EQUAL(loop.poll(0), 3u);
+    BOOST_CHECK((results == std::vector{1, 3, -1}));
+    BOOST_CHECK_EQUAL(loop.size(), added.size() + 1);
+    for (auto& p : added) {
+        loop.remove(p[0]);
+        close(p[0]);
+        close(p[1]);
+    }
+    loop.remove(a[0]);
+    close(a[0]);
+    close(a[1]);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(command_server_tests)
+// load generator: measures throughput and latency of round trips through a local socket
+BOOST_ANON_TEST_CASE() {
+    using namespace std::chrono;
+    const std::string path = std::format("/tmp/command_line_parser_test_{}.sock", getpid());
+    cmd::command_server<decltype(parser)> server{{.path = path, .workers = 4}};
+    server.on(1, [](const auto&, auto& p) { return std::string{p.var("var")}; });
+    server.on(3, [](const auto&, auto& p) { return std::to_string(p.variadic().size()); });
+    server.start();
+    constexpr std::size_t clients = 8, commands = 2000;
+    std::vector<std::vector<nanoseconds>> latencies(clients);
+    std::atomic<std::size_t> failures = 0;
+    auto client = [&](std::size_t id) {
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::ranges::copy(path, addr.sun_path);
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+            ++failures;
+            close(fd);
+            return;
+        }
+        std::string reply;
+        for (std::size_t i = 0; i < commands; ++i) {
+            std::string command, expected;
+            if (i % 2) {
+                command = "test arg8 arg9";
+                for (std::size_t j = 0; j < i % 7; ++j) command += " x";
+                expected = std::to_string(i % 7);
+            } else {
+                command = std::format("test arg1 arg2 --test_flag={}", i);
+                expected = std::to_string(i);
+            }
+            command.push_back('\n');
+            const auto start = steady_clock::now();
+            if (write(fd, command.data(), command.size()) != static_cast<ssize_t>(command.size())) {
+                ++failures;
+                break;
+            }
+            reply.clear();
+            char c;
+            while (read(fd, &c, 1) == 1 && c != '\n') reply.push_back(c);
+            latencies[id].push_back(steady_clock::now() - start);
+            if (reply != expected) ++failures;
+        }
+        close(fd);
+    };
+    const auto start = steady_clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t id = 0; id < clients; ++id) threads.emplace_back(client, id);
+    }
+    const duration<double> elapsed = steady_clock::now() - start;
+    server.stop();
+    BOOST_CHECK_EQUAL(failures.load(), 0u);
+    std::vector<nanoseconds> all;
+    for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    BOOST_REQUIRE_EQUAL(all.size(), clients * commands);
+    std::ranges::sort(all);
+    std::println("command_server: {:.0f} commands/s, p50 latency {}, p99 latency {}",
+        all.size() / elapsed.count(), duration_cast<microseconds>(all[all.size() / 2]),
+        duration_cast<microseconds>(all[all.size() * 99 / 100]));
+}
+static int connect_to(const std::string& path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::ranges::copy(path, addr.sun_path);
+    // keeps a broken server from hanging the tests
+    const timeval timeout{.tv_sec = 5, .tv_usec = 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+static std::string read_all(int fd) {
+    std::string data;
+    char buffer[4096];
+    ssize_t size;
+    while ((size = read(fd, buffer, sizeof(buffer))) > 0) data.append(buffer, size);
+    return data;
+}
+// a reply containing the line delimiter is replaced so that later replies stay in step
+BOOST_ANON_TEST_CASE() {
+    const std::string path = std::format("/tmp/command_line_parser_test_{}.sock", getpid());
+    cmd::command_server<decltype(parser)> server{{.path = path, .workers = 1}};
+    server.on(1, [](const auto&, auto& p) { return std::format("a\n{}", p.var("var")); });
+    server.on(3, [](const auto&, auto& p) { return std::to_string(p.variadic().size()); });
+    server.start();
+    const int fd = connect_to(path);
+    BOOST_REQUIRE(fd >= 0);
+    const std::string_view commands = "test arg1 arg2 --test_flag=x\ntest arg8 arg9 x x\n";
+    BOOST_REQUIRE_EQUAL(write(fd, commands.data(), commands.size()), static_cast<ssize_t>(commands.size()));
+    shutdown(fd, SHUT_WR);
+    BOOST_CHECK_EQUAL(read_all(fd), "\n2\n");
+    close(fd);
+    server.stop();
+}
+// a client that floods commands faster than they are handled is dropped
+BOOST_ANON_TEST_CASE() {
+    const std::string path = std::format("/tmp/command_line_parser_test_{}.sock", getpid());
+    cmd::command_server<decltype(parser)> server{{.path = path, .workers = 1, .max_pending_commands = 4}};
+    std::atomic<bool> release = false;
+    server.on(1, [&release](const auto&, auto&) {
+        release.wait(false);
+        return std::string{"done"};
+    });
+    server.start();
+    const int fd = connect_to(path);
+    BOOST_REQUIRE(fd >= 0);
+    std::string commands;
+    for (int i = 0; i < 64; ++i) commands += "test arg1 arg2 --test_flag=x\n";
+    BOOST_REQUIRE_EQUAL(write(fd, commands.data(), commands.size()), static_cast<ssize_t>(commands.size()));
+    BOOST_CHECK_EQUAL(read_all(fd), "");
+    release = true;
+    release.notify_all();
+    close(fd);
+    server.stop();
+}
+// a client that stops reading is dropped, and other clients of the same worker are still served
+BOOST_ANON_TEST_CASE() {
+    using namespace std::chrono_literals;
+    const std::string path = std::format("/tmp/command_line_parser_test_{}.sock", getpid());
+    cmd::command_server<decltype(parser)> server{{.path = path, .workers = 1, .write_timeout = 100ms}};
+    server.on(1, [](const auto&, auto&) { return std::string(1 << 24, 'x'); });
+    server.on(3, [](const auto&, auto& p) { return std::to_string(p.variadic().size()); });
+    server.start();
+    const int stalled = connect_to(path), fd = connect_to(path);
+    BOOST_REQUIRE(stalled >= 0 && fd >= 0);
+    const std::string_view large = "test arg1 arg2 --test_flag=x\n", small = "test arg8 arg9 x\n";
+    BOOST_REQUIRE_EQUAL(write(stalled, large.data(), large.size()), static_cast<ssize_t>(large.size()));
+    std::this_thread::sleep_for(50ms);
+    BOOST_REQUIRE_EQUAL(write(fd, small.data(), small.size()), static_cast<ssize_t>(small.size()));
+    shutdown(fd, SHUT_WR);
+    BOOST_CHECK_EQUAL(read_all(fd), "1\n");
+    BOOST_CHECK_LT(read_all(stalled).size(), std::size_t{1} << 24);
+    close(stalled);
+    close(fd);
+    server.stop();
+}
 BOOST_AUTO_TEST_SUITE_END()
 
 #define DEFINE_CHECKS_CASE(...) BOOST_ANON_TEST_CASE() {\
@@ -202,6 +1356,14 @@ DEFINE_CHECKS_CASE(
     .name = "Test application",
     .usages = {{"test <var>=arg1", 1}}
 )
+DEFINE_CHECKS_CASE(
+    .name = "Test application",
+    .usages = {{"test ->", 1}, {"test ->", 2}}
+)
+DEFINE_CHECKS_CASE(
+    .name = "Test application",
+    .usages = {{"test ...", 1}, {"test ->", 2}}
+)
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(wchar_tests)
@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <vector>
+#include "parser.hpp"
+
+namespace cmd {
+    inline constexpr std::array<std::string_view, trace_events_n> trace_event_names = {
+        "node_visit", "placeholder_hop", "var_capture", "flag_lookup", "hash_probe"
+    };
+
+    /// A step of a parse, as reported to a tracer.
+    struct trace_record {
+        trace_event event;
+        std::size_t node, arg;
+
+        constexpr bool operator==(const trace_record&) const noexcept = default;
+    };
+
+    /// Tracer that keeps the last `N` steps in a fixed buffer. It never allocates.
+    /// \tparam N: capacity of the buffer
+    template <std::size_t N>
+    requires (N > 0)
+    class ring_tracer {
+        std::array<trace_record, N> buffer_{};
+        /// \internal Number of steps recorded since the last `clear`.
+        std::size_t count_ = 0;
+    public:
+        constexpr void operator()(trace_event event, std::size_t node, std::size_t arg) noexcept {
+            buffer_[count_++ % N] = {event, node, arg};
+        }
+        /// \return number of steps in the buffer
+        constexpr std::size_t size() const noexcept {
+            return count_ < N ? count_ : N;
+        }
+        /// \return number of steps recorded, including those overwritten
+        constexpr std::size_t total() const noexcept {
+            return count_;
+        }
+        /// \param i: 0 for the oldest step in the buffer
+        constexpr const trace_record& operator[](std::size_t i) const noexcept {
+            return buffer_[(count_ - size() + i) % N];
+        }
+        /// \return steps in the buffer, from the oldest to the latest
+        constexpr auto records() const noexcept {
+            return views::iota(std::size_t{0}, size()) |
+                views::transform([this](std::size_t i) -> const trace_record& {return (*this)[i];});
+        }
+        constexpr void clear() noexcept {
+            count_ = 0;
+        }
+    };
+
+    /// Tracer that timestamps every step, and writes them as Chrome trace-event JSON,
+    /// which can be opened in `chrome://tracing` or Perfetto.
+    /// \remark Unlike `ring_tracer`, it allocates for every step, so it is meant for diagnosis only.
+    class chrome_tracer {
+        struct event {
+            trace_record record;
+            std::chrono::steady_clock::time_point time;
+        };
+        std::vector<event> events_;
+        std::chrono::steady_clock::time_point origin_ = std::chrono::steady_clock::now();
+    public:
+        /// \param pid, tid: process and thread ids shown in the viewer
+        std::size_t pid = 0, tid = 0;
+
+        void operator()(trace_event event, std::size_t node, std::size_t arg) {
+            events_.push_back({{event, node, arg}, std::chrono::steady_clock::now()});
+        }
+        /// \return number of steps recorded
+        std::size_t size() const noexcept {
+            return events_.size();
+        }
+        void clear() noexcept {
+            events_.clear();
+            origin_ = std::chrono::steady_clock::now();
+        }
+        /// Writes `{"traceEvents":[...]}`, with one instant event per step.
+        /// Timestamps are in microseconds since construction or the last `clear`.
+        template <std::output_iterator<char> Out>
+        Out write(Out out) const {
+            auto append = [&out](std::string_view str) {
+                out = ranges::copy(str, out).out;
+            };
+            auto append_number = [&append](auto n) {
+                char buffer[32];
+                append({buffer, std::to_chars(buffer, std::end(buffer), n).ptr});
+            };
+            append(R"({"traceEvents":[)");
+            bool first = true;
+            for (const auto& [record, time] : events_) {
+                if (!first) append(",");
+                first = false;
+                append(R"({"name":")");
+                append(trace_event_names[std::to_underlying(record.event)]);
+                append(R"(","ph":"i","s":"t","ts":)");
+                append_number(std::chrono::duration<double, std::micro>(time - origin_).count());
+                append(R"(,"pid":)");
+                append_number(pid);
+                append(R"(,"tid":)");
+                append_number(tid);
+                append(R"(,"args":{"node":)");
+                append_number(record.node);
+                append(R"(,"arg":)");
+                append_number(record.arg);
+                append("}}");
+            }
+            append("]}");
+            return out;
+        }
+    };
+
+    /// Tracer that counts how often each node of `Info.tree` matches an argument,
+    /// to be passed back to `define_parser` as a profile. It never allocates.
+    /// \remark Counts are indexed by `Info.node_origin`,
+    /// so a parser defined with a profile records a profile for the same usages.
+    template <tagged<parser_info_tag> auto& Info>
+    class node_profile {
+        std::array<std::uint64_t, Info.tree.size()> hits_{};
+        /// \internal The last node visited, which matched if the next visit is at a later argument.
+        std::size_t last_node_ = 0, last_arg_ = -1;
+    public:
+        constexpr void operator()(trace_event event, std::size_t node, std::size_t arg) noexcept {
+            if (event != trace_event::node_visit) return;
+            if (arg > last_arg_) ++hits_[Info.node_origin[last_node_]];
+            last_node_ = node;
+            last_arg_ = arg;
+        }
+        /// \return number of matches of each node
+        constexpr const auto& hits() const noexcept {
+            return hits_;
+        }
+        /// Writes the counts separated by commas, to be included in the initializer of a `std::array`.
+        template <std::output_iterator<char> Out>
+        Out write(Out out) const {
+            for (std::size_t i = 0; i < hits_.size(); ++i) {
+                if (i) *out++ = ',';
+                char buffer[32];
+                out = ranges::copy(std::string_view{buffer, std::to_chars(buffer, std::end(buffer), hits_[i]).ptr},
+                    out).out;
+            }
+            return out;
+        }
+        constexpr void clear() noexcept {
+            hits_ = {};
+            last_arg_ = -1;
+        }
+    };
+}
\ No newline at end of file